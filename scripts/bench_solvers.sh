@@ -0,0 +1,75 @@
+#!/bin/bash
+
+# Runs the predictor on the benchmark traces once per solver and prints the
+# time taken and the races predicted side by side.
+
+SCRIPT_DIR="$(dirname "$(realpath "$0")")"
+PROJECT_DIR="$(dirname "$SCRIPT_DIR")"
+TRACES_DIR="$PROJECT_DIR/traces"
+PROGRAM="$PROJECT_DIR/build/predictor"
+
+TIMEOUT=600
+SOLVERS=("z3" "dl")
+
+if [ ! -f "$PROGRAM" ]; then
+    echo "Error: $PROGRAM not found"
+    exit 1
+fi
+
+if command -v gtimeout > /dev/null; then
+    TIMEOUT_CMD=gtimeout
+else
+    TIMEOUT_CMD=timeout
+fi
+
+BENCHMARK_TRACES=(
+    "jigsaw"
+    "account"
+    "airlinetickets"
+    "array"
+    "boundedbuffer"
+    "bubblesort"
+    "clean"
+    "critical"
+    "lang"
+    "mergesort"
+    "pingpong"
+    "producerconsumer"
+    "raytracer"
+    "twostage"
+    "wronglock"
+)
+
+printf "%-18s" "trace"
+for solver in "${SOLVERS[@]}"; do
+    printf "%14s %8s" "$solver time" "races"
+done
+echo
+
+for trace in "${BENCHMARK_TRACES[@]}"; do
+
+    if [ ! -f "$TRACES_DIR/$trace" ]; then
+        echo "Error: $trace not found"
+        continue
+    fi
+
+    printf "%-18s" "$trace"
+    for solver in "${SOLVERS[@]}"; do
+        OUTPUT=$($TIMEOUT_CMD $TIMEOUT "$PROGRAM" -f "$TRACES_DIR/$trace" \
+            --solver "$solver" 2>&1)
+        EXIT_CODE=$?
+
+        if [ $EXIT_CODE -eq 124 ]; then
+            printf "%14s %8s" "timeout" "-"
+            continue
+        elif [ $EXIT_CODE -ne 0 ]; then
+            printf "%14s %8s" "exit $EXIT_CODE" "-"
+            continue
+        fi
+
+        TIME=$(echo "$OUTPUT" | grep -oE "Time taken: [0-9]+ms" | grep -oE "[0-9]+")
+        RACES=$(echo "$OUTPUT" | grep -oE "races predicted: [0-9]+" | grep -oE "[0-9]+")
+        printf "%14s %8s" "${TIME}ms" "$RACES"
+    done
+    echo
+done
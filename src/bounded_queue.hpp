@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+/**
+ * BoundedQueue hands items from one pipeline stage to the next. push waits
+ * while the queue is full, so a producer cannot run ahead of its consumer
+ * without bound, and pop waits for an item. Once the producer closes the
+ * queue, pop hands out what is left and then returns false.
+ */
+template <typename T>
+class BoundedQueue {
+   public:
+    struct Stats {
+        uint64_t pushed = 0;
+        uint64_t full_waits = 0;  // pushes that found the queue full
+    };
+
+   private:
+    size_t capacity_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    Stats stats_;
+
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+
+   public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(std::max<size_t>(capacity, 1)) {}
+
+    /* false if the queue was closed, the item is dropped then */
+    bool push(T item) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (items_.size() >= capacity_ && !closed_) stats_.full_waits++;
+            not_full_.wait(lock, [this]() {
+                return items_.size() < capacity_ || closed_;
+            });
+            if (closed_) return false;
+
+            items_.push_back(std::move(item));
+            stats_.pushed++;
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /* false once the queue is closed and empty */
+    bool pop(T& item) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock,
+                            [this]() { return !items_.empty() || closed_; });
+            if (items_.empty()) return false;
+
+            item = std::move(items_.front());
+            items_.pop_front();
+        }
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            closed_ = true;
+        }
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    Stats getStats() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return stats_;
+    }
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "event.hpp"
+#include "trace.hpp"
+#include "vector_clock.hpp"
+
+/**
+ * CandidateWriteEngine computes the writes a read may observe. The good
+ * writes (same value) of a read are reduced to the maximal ones: a good write
+ * is dropped when the read happens before it or when it happens before
+ * another good write that happens before the read. The bad writes (different
+ * value) are reduced to the ones the read does not happen before.
+ *
+ * Writes of a variable are indexed per value and per thread. Along a thread
+ * both "happens before the read" and "the read happens before it" are
+ * monotone, so each (value, thread) list only needs two frontiers per read:
+ * the number of writes that happen before the read and the number of writes
+ * the read does not happen before. All reads of a variable can therefore be
+ * answered by one merge style sweep that only moves the frontiers forward.
+ */
+class CandidateWriteEngine {
+   public:
+    struct Candidates {
+        std::vector<Event> good_writes;
+        std::vector<Event> bad_writes;
+    };
+
+   private:
+    /* one list of writes of a variable with the same value in one thread */
+    struct WriteList {
+        uint32_t value;
+        TID tid;
+        std::vector<Event> writes;
+    };
+
+    struct Frontier {
+        size_t hb_read = 0;         // writes that happen before the read
+        size_t not_after_read = 0;  // writes the read does not happen before
+    };
+
+    const MHBClocks& clocks_;
+
+    std::unordered_map<uint32_t, std::vector<WriteList>> var_to_write_lists_;
+    std::unordered_map<uint32_t, std::unordered_map<TID, std::vector<Event>>>
+        var_to_thread_reads_;
+
+    std::unordered_set<uint32_t> prepared_vars_;
+    std::unordered_map<EID, Candidates> read_to_candidates_;
+
+    void advance(const WriteList& list, const Event& read,
+                 Frontier& frontier) const {
+        while (frontier.hb_read < list.writes.size() &&
+               clocks_.happensBefore(list.writes[frontier.hb_read], read))
+            frontier.hb_read++;
+
+        if (frontier.not_after_read < frontier.hb_read)
+            frontier.not_after_read = frontier.hb_read;
+
+        while (frontier.not_after_read < list.writes.size() &&
+               !clocks_.happensBefore(read, list.writes[frontier.not_after_read]))
+            frontier.not_after_read++;
+    }
+
+    Candidates collect(const std::vector<WriteList>& lists,
+                       const std::vector<Frontier>& frontiers,
+                       const Event& read) const {
+        Candidates res;
+
+        /* writes up to dominated[t] in thread t happen before a good write
+         * that happens before the read */
+        std::unordered_map<TID, uint32_t> dominated;
+        for (size_t i = 0; i < lists.size(); ++i) {
+            if (lists[i].value != read.getTargetValue() ||
+                frontiers[i].hb_read == 0)
+                continue;
+
+            const Event& last = lists[i].writes[frontiers[i].hb_read - 1];
+            for (size_t j = 0; j < lists.size(); ++j) {
+                TID tid = lists[j].tid;
+                uint32_t bound = tid == last.getThreadId()
+                                     ? clocks_.getLocalIdx(last) - 1
+                                     : clocks_.getClock(last, tid);
+                dominated[tid] = std::max(dominated[tid], bound);
+            }
+        }
+
+        for (size_t i = 0; i < lists.size(); ++i) {
+            const WriteList& list = lists[i];
+            if (list.value != read.getTargetValue()) {
+                res.bad_writes.insert(
+                    res.bad_writes.end(), list.writes.begin(),
+                    list.writes.begin() + frontiers[i].not_after_read);
+                continue;
+            }
+
+            uint32_t bound = dominated[list.tid];
+            for (size_t k = 0; k < frontiers[i].not_after_read; ++k) {
+                if (clocks_.getLocalIdx(list.writes[k]) > bound)
+                    res.good_writes.push_back(list.writes[k]);
+            }
+        }
+
+        auto byEventId = [](const Event& e1, const Event& e2) {
+            return e1.getEventId() < e2.getEventId();
+        };
+        std::sort(res.good_writes.begin(), res.good_writes.end(), byEventId);
+        std::sort(res.bad_writes.begin(), res.bad_writes.end(), byEventId);
+
+        return res;
+    }
+
+   public:
+    CandidateWriteEngine(const Trace& trace, const MHBClocks& clocks)
+        : clocks_(clocks) {
+        std::unordered_map<uint32_t, std::unordered_map<uint64_t, size_t>>
+            list_idx;
+
+        for (const Event& e : trace.getAllEvents()) {
+            if (e.getEventType() == Event::EventType::Read) {
+                var_to_thread_reads_[e.getTargetId()][e.getThreadId()]
+                    .push_back(e);
+            } else if (e.getEventType() == Event::EventType::Write) {
+                std::vector<WriteList>& lists =
+                    var_to_write_lists_[e.getTargetId()];
+                uint64_t key =
+                    (static_cast<uint64_t>(e.getTargetValue()) << 8) |
+                    e.getThreadId();
+
+                auto [it, inserted] =
+                    list_idx[e.getTargetId()].emplace(key, lists.size());
+                if (inserted)
+                    lists.push_back({e.getTargetValue(), e.getThreadId(), {}});
+                lists[it->second].writes.push_back(e);
+            }
+        }
+    }
+
+    /**
+     * Computes the candidates of every read of the variable by one thread in
+     * a single sweep. Does not touch the cache, so it is safe to call from
+     * several threads at once.
+     */
+    std::vector<std::pair<Event, Candidates>> sweepThreadReads(
+        uint32_t var_id, TID tid) const {
+        std::vector<std::pair<Event, Candidates>> res;
+
+        auto reads = var_to_thread_reads_.find(var_id);
+        if (reads == var_to_thread_reads_.end()) return res;
+        auto threadReads = reads->second.find(tid);
+        if (threadReads == reads->second.end()) return res;
+
+        static const std::vector<WriteList> no_writes;
+        auto it = var_to_write_lists_.find(var_id);
+        const std::vector<WriteList>& lists =
+            it == var_to_write_lists_.end() ? no_writes : it->second;
+
+        std::vector<Frontier> frontiers(lists.size());
+        for (const Event& read : threadReads->second) {
+            for (size_t i = 0; i < lists.size(); ++i)
+                advance(lists[i], read, frontiers[i]);
+
+            res.emplace_back(read, collect(lists, frontiers, read));
+        }
+
+        return res;
+    }
+
+    /* variables read by the thread */
+    std::vector<uint32_t> getVariablesReadBy(TID tid) const {
+        std::vector<uint32_t> vars;
+        for (const auto& [varId, threadReads] : var_to_thread_reads_) {
+            if (threadReads.find(tid) != threadReads.end())
+                vars.push_back(varId);
+        }
+        return vars;
+    }
+
+    /**
+     * Computes the candidates of every read of the variable in one sweep per
+     * reading thread and caches them until they are taken.
+     */
+    void prepareVariable(uint32_t var_id) {
+        if (!prepared_vars_.insert(var_id).second) return;
+
+        auto reads = var_to_thread_reads_.find(var_id);
+        if (reads == var_to_thread_reads_.end()) return;
+
+        for (const auto& [tid, _] : reads->second) {
+            for (auto& [read, candidates] : sweepThreadReads(var_id, tid))
+                read_to_candidates_[read.getEventId()] = std::move(candidates);
+        }
+    }
+
+    /**
+     * Returns the candidate writes of a read, sorted in trace order. The
+     * cached entry is released since every read is only encoded once.
+     */
+    Candidates takeCandidates(const Event& read) {
+        assert(read.getEventType() == Event::EventType::Read);
+        prepareVariable(read.getTargetId());
+
+        auto it = read_to_candidates_.find(read.getEventId());
+        if (it == read_to_candidates_.end()) return Candidates();
+
+        Candidates res = std::move(it->second);
+        read_to_candidates_.erase(it);
+        return res;
+    }
+
+    /**
+     * Drops the writes that happen before the dominating event, e.g. the
+     * previous write to the same variable in the reading thread.
+     */
+    void filterDominated(std::vector<Event>& writes,
+                         const Event& dominator) const {
+        writes.erase(std::remove_if(writes.begin(), writes.end(),
+                                    [&dominator, this](const Event& write) {
+                                        return clocks_.happensBefore(write,
+                                                                     dominator);
+                                    }),
+                     writes.end());
+    }
+};
@@ -1,5 +1,18 @@
 #include "casual_model.hpp"
 
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
 void CasualModel::filterCOPs() {
     for (const auto& [e1, e2] : trace_.getCOPs()) {
         if (mhb_closure_.happensBefore(e1, e2) ||
@@ -10,10 +23,20 @@ void CasualModel::filterCOPs() {
     }
 }
 
-void CasualModel::generateZ3VarMap() {
-    for (const auto& event : trace_.getAllEvents()) {
-        var_map_.push_back(getEventOrderZ3Expr(event));
-    }
+void CasualModel::prioritizeCOPs() {
+    LOG_INIT_COUT();
+    COPScheduler scheduler(trace_, mhb_clocks_);
+
+    std::vector<std::pair<Event, Event>> ordered;
+    ordered.reserve(filtered_cop_events_.size());
+    for (size_t i : scheduler.order(filtered_cop_events_))
+        ordered.push_back(filtered_cop_events_[i]);
+    filtered_cop_events_ = std::move(ordered);
+
+    const COPScheduler::Stats& stats = scheduler.getStats();
+    log(LOG_INFO) << "COPs ordered by cost: " << stats.cops << " COPs over "
+                  << stats.groups << " variable and thread pairs, "
+                  << stats.passes << " passes\n";
 }
 
 void CasualModel::generateMHBConstraints() {
@@ -30,8 +53,9 @@ void CasualModel::generateMHBConstraints() {
             Event e1 = events[i - 1];
             Event e2 = events[i];
 
-            mhb_constraints_.push_back(var_map_[getEventIdx(e1)] <
-                                       var_map_[getEventIdx(e2)]);
+            mhb_constraints_.push_back(getEventOrderZ3Expr(e1) <
+                                       getEventOrderZ3Expr(e2));
+            mhb_edges_.emplace_back(e1, e2);
 
             if (e1.getEventType() == Event::EventType::Fork ||
                 e2.getEventType() == Event::EventType::Join) {
@@ -44,20 +68,20 @@ void CasualModel::generateMHBConstraints() {
     }
 
     for (const auto& [forkEvent, beginEvent] : trace_.getForkBeginPairs()) {
-        mhb_constraints_.push_back(var_map_[getEventIdx(forkEvent)] <
-                                   var_map_[getEventIdx(beginEvent)]);
+        mhb_constraints_.push_back(getEventOrderZ3Expr(forkEvent) <
+                                   getEventOrderZ3Expr(beginEvent));
+        mhb_edges_.emplace_back(forkEvent, beginEvent);
         builder.addRelation(forkEvent, beginEvent);
     }
 
     for (const auto& [endEvent, joinEvent] : trace_.getEndJoinPairs()) {
-        mhb_constraints_.push_back(var_map_[getEventIdx(endEvent)] <
-                                   var_map_[getEventIdx(joinEvent)]);
+        mhb_constraints_.push_back(getEventOrderZ3Expr(endEvent) <
+                                   getEventOrderZ3Expr(joinEvent));
+        mhb_edges_.emplace_back(endEvent, joinEvent);
         builder.addRelation(endEvent, joinEvent);
     }
 
     mhb_closure_ = builder.build();
-
-    s_.add(mhb_constraints_);
 }
 
 void CasualModel::generateLockConstraints() {
@@ -76,120 +100,331 @@ void CasualModel::generateLockConstraints() {
                                                lr1.getAcqEvent()))
                     continue;
 
-                z3::expr rel1_lt_acq2 =
-                    var_map_[getEventIdx(lr1.getRelEvent())] <
-                    var_map_[getEventIdx(lr2.getAcqEvent())];
-                z3::expr rel2_lt_acq1 =
-                    var_map_[getEventIdx(lr2.getRelEvent())] <
-                    var_map_[getEventIdx(lr1.getAcqEvent())];
-
-                lock_constraints_.push_back(rel1_lt_acq2 ^ rel2_lt_acq1);
+                lock_constraints_.push_back(makeLockConstraint(lr1, lr2));
+                lock_pairs_.emplace_back(lr1, lr2);
             }
         }
     }
-
-    s_.add(lock_constraints_);
 }
 
-z3::expr CasualModel::getPhiConc(Event e) {
+void CasualModel::generateSweepLockConstraints() {
     LOG_INIT_COUT();
+    LockConstraintEngine engine(trace_, mhb_closure_);
+
+    for (const auto& [lr1, lr2] : engine.generate()) {
+        lock_constraints_.push_back(makeLockConstraint(lr1, lr2));
+        lock_pairs_.emplace_back(lr1, lr2);
+    }
+
+    const LockConstraintEngine::Stats& stats = engine.getStats();
+    uint64_t reduced = stats.pairwise_pairs - stats.emitted_pairs;
+    log(LOG_INFO) << "Lock constraints: " << stats.emitted_pairs << " of "
+                  << stats.pairwise_pairs << " pairwise ("
+                  << stats.total_pairs << " cross thread region pairs, "
+                  << stats.nested_pairs << " implied by enclosing locks, "
+                  << (stats.pairwise_pairs
+                          ? 100.0 * reduced / stats.pairwise_pairs
+                          : 0.0)
+                  << "% fewer)\n";
+}
+
+PhiDef::Kind CasualModel::foldOrder(const Event& e1, const Event& e2) {
+    if (hb(e1, e2)) return PhiDef::Kind::True;
+    if (e1 == e2 || hb(e2, e1)) return PhiDef::Kind::False;
+    return PhiDef::Kind::Residue;
+}
+
+PhiDef::Kind CasualModel::getPhiKind(const Event& e) {
+    if (Event::isNullEvent(e)) return PhiDef::Kind::True;
+
+    const PhiDef& def = buildPhiDef(e);
+
+    /* a read still being built is part of a cycle, keep it symbolic */
+    return def.building ? PhiDef::Kind::Residue : def.kind;
+}
+
+bool CasualModel::foldClause(PhiClause& clause, const PhiDef& def) {
+    phi_fold_stats_.clauses++;
+
+    std::vector<std::pair<Event, Event>> order;
+    for (const auto& [e1, e2] : clause.order) {
+        PhiDef::Kind kind = foldOrder(e1, e2);
+        if (kind == PhiDef::Kind::False) return false;
+        if (kind == PhiDef::Kind::Residue) order.emplace_back(e1, e2);
+    }
+    clause.order = std::move(order);
+
+    std::vector<Event> phiReads;
+    for (const Event& read : clause.phi_reads) {
+        PhiDef::Kind kind = getPhiKind(read);
+        if (kind == PhiDef::Kind::False) return false;
+        if (kind == PhiDef::Kind::Residue) phiReads.push_back(read);
+    }
+    clause.phi_reads = std::move(phiReads);
+
+    if (clause.check_bad_writes) {
+        bool interferes = false;
+        for (const Event& badWrite : def.bad_writes) {
+            if (hb(badWrite, clause.source)) continue;
+
+            /* source < bad write < read is forced */
+            if (hb(clause.source, badWrite) && hb(badWrite, def.read))
+                return false;
+            interferes = true;
+        }
+        clause.check_bad_writes = interferes;
+    }
+
+    return true;
+}
+
+const PhiDef& CasualModel::buildPhiDef(const Event& e) {
     assert(e.getEventType() == Event::EventType::Read);
 
-    if (read_to_phi_conc_offset_.find(e.getEventId()) == read_to_phi_conc_offset_.end()) {
-        read_to_phi_conc_offset_[e.getEventId()] = read_to_phi_conc_.size();
-        read_to_phi_conc_.push_back(getEventPhiZ3Expr(e));
+    auto it = read_to_phi_def_.find(e.getEventId());
+    if (it != read_to_phi_def_.end()) return it->second;
 
-        z3::expr phiAbs = getPhiAbs(e);
-        z3::expr phiSC = getPhiSC(e);
+    buildPhiDefs(e);
+    return read_to_phi_def_.at(e.getEventId());
+}
 
-        z3::expr phiConc = phiAbs & phiSC;
+PhiDef& CasualModel::startPhiDef(const Event& e) {
+    PhiDef& def = read_to_phi_def_[e.getEventId()];
+    def.read = e;
+    def.prev_read = trace_.getPrevReadInThread(e);
+    phi_fold_stats_.reads++;
+    return def;
+}
+
+void CasualModel::buildPhiDefs(const Event& root) {
+    /* Explicit worklist instead of recursion: a frame first waits for the
+     * phi_abs read of its thread, then collects its clauses and waits for
+     * the reads they reference, and is finally folded. A referenced read
+     * that is still on the stack is part of a cycle and stays symbolic. */
+    struct Frame {
+        Event read;
+        uint32_t stage;
+        size_t next_dep;
+        std::vector<Event> deps;
+    };
+
+    auto isMissing = [this](const Event& e) {
+        return !Event::isNullEvent(e) &&
+               read_to_phi_def_.find(e.getEventId()) == read_to_phi_def_.end();
+    };
+
+    if (!isMissing(root)) return;
+
+    std::vector<Frame> stack;
+    startPhiDef(root);
+    stack.push_back({root, 0, 0, {}});
+
+    while (!stack.empty()) {
+        Frame& frame = stack.back();
+        PhiDef& def = read_to_phi_def_.at(frame.read.getEventId());
+
+        if (frame.stage == 0) {
+            frame.stage = 1;
+            if (isMissing(def.prev_read)) {
+                Event prevRead = def.prev_read;
+                startPhiDef(prevRead);
+                stack.push_back({prevRead, 0, 0, {}});
+                continue;
+            }
+        }
+
+        if (frame.stage == 1) {
+            frame.stage = 2;
+
+            if (getPhiKind(def.prev_read) == PhiDef::Kind::False) {
+                /* an infeasible earlier read makes the whole thread suffix
+                 * infeasible, there is no need to look at the writes */
+                finishPhiDef(def, PhiDef::Kind::False);
+                stack.pop_back();
+                continue;
+            }
 
-        read_to_phi_conc_.set(read_to_phi_conc_offset_[e.getEventId()], phiConc);
+            auto raw = raw_phi_defs_.find(def.read.getEventId());
+            if (raw != raw_phi_defs_.end()) {
+                def.clauses = std::move(raw->second.clauses);
+                def.bad_writes = std::move(raw->second.bad_writes);
+                raw_phi_defs_.erase(raw);
+            } else {
+                collectPhiClauses(def,
+                                  candidate_engine_.takeCandidates(def.read));
+            }
+
+            for (const PhiClause& clause : def.clauses) {
+                frame.deps.insert(frame.deps.end(), clause.phi_reads.begin(),
+                                  clause.phi_reads.end());
+            }
+        }
+
+        bool pushed = false;
+        while (frame.next_dep < frame.deps.size()) {
+            Event dep = frame.deps[frame.next_dep++];
+            if (isMissing(dep)) {
+                startPhiDef(dep);
+                stack.push_back({dep, 0, 0, {}});
+                pushed = true;
+                break;
+            }
+        }
+        if (pushed) continue;
+
+        finishPhiDef(def, foldPhiSC(def));
+        stack.pop_back();
     }
+}
+
+void CasualModel::finishPhiDef(PhiDef& def, PhiDef::Kind scKind) {
+    PhiDef::Kind absKind = getPhiKind(def.prev_read);
 
-    return getEventPhiZ3Expr(e);
+    if (absKind == PhiDef::Kind::False || scKind == PhiDef::Kind::False) {
+        def.kind = PhiDef::Kind::False;
+    } else if (scKind == PhiDef::Kind::True) {
+        def.kind = absKind;
+        if (absKind == PhiDef::Kind::Residue) {
+            def.same_as_prev = true;
+            phi_fold_stats_.aliased_reads++;
+        }
+    } else {
+        def.kind = PhiDef::Kind::Residue;
+    }
+
+    if (def.kind != PhiDef::Kind::Residue || def.same_as_prev) {
+        def.clauses.clear();
+        def.bad_writes.clear();
+    }
+
+    if (def.kind == PhiDef::Kind::True) phi_fold_stats_.true_reads++;
+    if (def.kind == PhiDef::Kind::False) phi_fold_stats_.false_reads++;
+
+    def.building = false;
 }
 
-z3::expr CasualModel::getPhiAbs(Event e) {
-    LOG_INIT_COUT();
-    Event prevRead = trace_.getPrevReadInThread(e);
+PhiDef::Kind CasualModel::foldPhiSC(PhiDef& def) {
+    std::vector<PhiClause> clauses = std::move(def.clauses);
+    def.clauses.clear();
+
+    PhiDef::Kind kind = PhiDef::Kind::False;
+    for (PhiClause& clause : clauses) {
+        if (!foldClause(clause, def)) {
+            phi_fold_stats_.folded_clauses++;
+            continue;
+        }
 
-    if (Event::isNullEvent(prevRead)) return c_.bool_val(true);
+        if (clause.order.empty() && clause.phi_reads.empty() &&
+            !clause.check_bad_writes) {
+            phi_fold_stats_.folded_clauses++;
+            def.clauses.clear();
+            return PhiDef::Kind::True;
+        }
 
-    return getPhiConc(prevRead);
+        kind = PhiDef::Kind::Residue;
+        def.clauses.push_back(std::move(clause));
+    }
+
+    return kind;
 }
 
-z3::expr CasualModel::getPhiSC(Event e) {
-    assert(e.getEventType() == Event::EventType::Read);
+void CasualModel::preparePhiClauses(unsigned threadCount) {
     LOG_INIT_COUT();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<Thread> threads = trace_.getThreads();
+    std::vector<std::unordered_map<EID, PhiDef>> results(threadCount);
+    std::vector<std::thread> workers;
+
+    /* the clauses of a read only depend on the trace and the clocks, so
+     * the reads of different threads are collected independently */
+    for (unsigned w = 0; w < threadCount; ++w) {
+        workers.emplace_back([this, w, threadCount, &threads, &results]() {
+            for (size_t t = w; t < threads.size(); t += threadCount) {
+                TID tid = threads[t].getThreadId();
+                for (uint32_t varId : candidate_engine_.getVariablesReadBy(tid)) {
+                    for (auto& [read, candidates] :
+                         candidate_engine_.sweepThreadReads(varId, tid)) {
+                        PhiDef& def = results[w][read.getEventId()];
+                        def.read = read;
+                        collectPhiClauses(def, std::move(candidates));
+                    }
+                }
+            }
+        });
+    }
+
+    for (std::thread& worker : workers) worker.join();
+
+    for (auto& result : results) raw_phi_defs_.merge(result);
 
-    std::vector<Event> goodWrites = trace_.getGoodWritesForRead(e);
-    std::vector<Event> badWrites = trace_.getBadWritesForRead(e);
+    auto end = std::chrono::high_resolution_clock::now();
+    log(LOG_INFO) << "Collected phi clauses of " << raw_phi_defs_.size()
+                  << " reads on " << threadCount << " threads in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                         end - start)
+                         .count()
+                  << "ms\n";
+}
+
+void CasualModel::collectPhiClauses(
+    PhiDef& def, CandidateWriteEngine::Candidates candidates) const {
+    const Event& e = def.read;
+
+    std::vector<Event>& goodWrites = candidates.good_writes;
+    std::vector<Event>& badWrites = candidates.bad_writes;
 
     bool sameInitialValue = trace_.hasSameInitialValue(e);
 
     Event sameThreadSameVarPrevWrite = trace_.getSameThreadSameVarPrevWrite(e);
 
-    generalGoodWritesFilter(goodWrites, e);
-    generalBadWritesFilter(badWrites, e);
-
-    z3::expr_vector maintainReadValConstraints(c_);
+    std::vector<PhiClause>& clauses = def.clauses;
 
     if (sameInitialValue) {
-        z3::expr_vector rfConstraints(c_);
+        PhiClause clause;
         for (const Event& badWrite : badWrites) {
-            rfConstraints.push_back(var_map_[getEventIdx(e)] <
-                                    var_map_[getEventIdx(badWrite)]);
+            clause.order.emplace_back(e, badWrite);
         }
 
         /* If same initial value, it does not need a good write. Without the
          * below constraints we cannot capture this scenario */
         for (const Event& goodWrite : goodWrites) {
-            rfConstraints.push_back(var_map_[getEventIdx(e)] <
-                                    var_map_[getEventIdx(goodWrite)]);
+            clause.order.emplace_back(e, goodWrite);
         }
-        if (rfConstraints.size() > 0)
-            maintainReadValConstraints.push_back(z3::mk_and(rfConstraints));
+        clauses.push_back(std::move(clause));
     }
 
     if (!Event::isNullEvent(sameThreadSameVarPrevWrite)) {
         /* case 1 optimization: extra filtering */
-        prevWriteExistFilter(goodWrites, sameThreadSameVarPrevWrite);
-        prevWriteExistFilter(badWrites, sameThreadSameVarPrevWrite);
+        candidate_engine_.filterDominated(goodWrites,
+                                          sameThreadSameVarPrevWrite);
+        candidate_engine_.filterDominated(badWrites,
+                                          sameThreadSameVarPrevWrite);
 
         if (sameThreadSameVarPrevWrite.getTargetValue() == e.getTargetValue()) {
-            z3::expr_vector rfConstraints(c_);
-            for (const Event& badWrite : badWrites) {
-                rfConstraints.push_back(
-                    makeRFConstraint(e, sameThreadSameVarPrevWrite, badWrite));
-            }
-            if (rfConstraints.size() > 0)
-                maintainReadValConstraints.push_back(z3::mk_and(rfConstraints));
+            PhiClause clause;
+            clause.source = sameThreadSameVarPrevWrite;
+            clause.check_bad_writes = true;
+            clauses.push_back(std::move(clause));
         }
 
         for (const Event& goodWrite : goodWrites) {
-            z3::expr_vector rfConstraints(c_);
+            PhiClause clause;
+            clause.source = goodWrite;
+            clause.check_bad_writes = true;
 
-            rfConstraints.push_back(getPhiAbs(goodWrite));
-            rfConstraints.push_back(var_map_[getEventIdx(goodWrite)] <
-                                    var_map_[getEventIdx(e)]);
+            Event goodWritePrevRead = trace_.getPrevReadInThread(goodWrite);
+            if (!Event::isNullEvent(goodWritePrevRead))
+                clause.phi_reads.push_back(goodWritePrevRead);
+            clause.order.emplace_back(goodWrite, e);
 
             /* case 1.2 optimization: extra constraints */
             if (sameThreadSameVarPrevWrite.getTargetValue() !=
                 e.getTargetValue())
-                rfConstraints.push_back(
-                    var_map_[getEventIdx(sameThreadSameVarPrevWrite)] <
-                    var_map_[getEventIdx(goodWrite)]);
+                clause.order.emplace_back(sameThreadSameVarPrevWrite,
+                                          goodWrite);
 
-            for (const Event& badWrite : badWrites) {
-                if (hb(badWrite, goodWrite)) continue;
-
-                rfConstraints.push_back(
-                    makeRFConstraint(e, goodWrite, badWrite));
-            }
-
-            if (rfConstraints.size() > 0)
-                maintainReadValConstraints.push_back(z3::mk_and(rfConstraints));
+            clauses.push_back(std::move(clause));
         }
     } else {
         /* case 2: has no write event on the same thread previously */
@@ -198,81 +433,1487 @@ z3::expr CasualModel::getPhiSC(Event e) {
         if (!Event::isNullEvent(sameThreadPrevDiffRead)) {
             /* we can treat the prev diff read as a 'bad write' and filter out
              * all good writes that hb this prev diff read */
-            prevWriteExistFilter(goodWrites, sameThreadPrevDiffRead);
+            candidate_engine_.filterDominated(goodWrites,
+                                              sameThreadPrevDiffRead);
 
             // TODO: Should I filter out bad writes that hb this prev diff read
             // as well?
         }
 
         for (const Event& goodWrite : goodWrites) {
-            z3::expr_vector rfConstraints(c_);
+            PhiClause clause;
+            clause.source = goodWrite;
+            clause.check_bad_writes = true;
 
-            rfConstraints.push_back(getPhiAbs(goodWrite));
-            rfConstraints.push_back(var_map_[getEventIdx(goodWrite)] <
-                                    var_map_[getEventIdx(e)]);
+            Event goodWritePrevRead = trace_.getPrevReadInThread(goodWrite);
+            if (!Event::isNullEvent(goodWritePrevRead))
+                clause.phi_reads.push_back(goodWritePrevRead);
+            clause.order.emplace_back(goodWrite, e);
 
             if (!Event::isNullEvent(sameThreadPrevDiffRead))
-                rfConstraints.push_back(
-                    var_map_[getEventIdx(sameThreadPrevDiffRead)] <
-                    var_map_[getEventIdx(goodWrite)]);
+                clause.order.emplace_back(sameThreadPrevDiffRead, goodWrite);
 
-            for (const Event& badWrite : badWrites) {
-                if (hb(badWrite, goodWrite)) continue;
+            clauses.push_back(std::move(clause));
+        }
+    }
 
-                rfConstraints.push_back(
-                    makeRFConstraint(e, goodWrite, badWrite));
-            }
+    def.bad_writes = std::move(badWrites);
+}
+
+z3::expr CasualModel::getPhiConc(Event e) {
+    /* follow the reads whose phi_conc is just their phi_abs */
+    while (!Event::isNullEvent(e)) {
+        const PhiDef& def = buildPhiDef(e);
+        if (def.building || !def.same_as_prev) break;
+        e = def.prev_read;
+    }
+
+    switch (getPhiKind(e)) {
+        case PhiDef::Kind::True:
+            return c_.bool_val(true);
+        case PhiDef::Kind::False:
+            return c_.bool_val(false);
+        default:
+            return getEventPhiZ3Expr(e);
+    }
+}
+
+z3::expr CasualModel::getPhiAbs(Event e) {
+    return getPhiConc(trace_.getPrevReadInThread(e));
+}
+
+z3::expr CasualModel::encodePhiDef(const PhiDef& def) {
+    assert(def.kind == PhiDef::Kind::Residue);
+
+    z3::expr_vector maintainReadValConstraints(c_);
+    bool hasSource = false;
+
+    for (const PhiClause& clause : def.clauses) {
+        z3::expr_vector rfConstraints(c_);
+
+        for (const auto& [e1, e2] : clause.order) {
+            rfConstraints.push_back(orderAtom(e1, e2));
+        }
 
-            if (rfConstraints.size() > 0)
-                maintainReadValConstraints.push_back(z3::mk_and(rfConstraints));
+        for (const Event& read : clause.phi_reads) {
+            rfConstraints.push_back(getPhiConc(read));
         }
+
+        if (clause.check_bad_writes) {
+            hasSource = true;
+            maintainReadValConstraints.push_back(
+                makeRFClause(def.read, clause.source, rfConstraints,
+                             def.bad_writes));
+        } else {
+            maintainReadValConstraints.push_back(z3::mk_and(rfConstraints));
+        }
+    }
+
+    if (options_.rf_encoding == RFEncoding::Selector && hasSource) {
+        /* the write observed by the read is the selected source, so no bad
+         * write may be placed between the source and the read */
+        const Event& e = def.read;
+        z3::expr source = getRFSourceZ3Expr(e);
+        for (const Event& badWrite : def.bad_writes) {
+            /* a bad write outside the cone comes after the read */
+            if (!inCone(badWrite)) continue;
+
+            z3::expr bw = getEventOrderZ3Expr(badWrite);
+            if (hb(badWrite, e))
+                rf_constraints_.push_back(bw < source);
+            else
+                rf_constraints_.push_back(bw < source ||
+                                          getEventOrderZ3Expr(e) < bw);
+        }
+    }
+
+    return getPhiConc(def.prev_read) && z3::mk_or(maintainReadValConstraints);
+}
+
+void CasualModel::encodePhiDefs() {
+    LOG_INIT_COUT();
+
+    for (const auto& [read, def] : read_to_phi_def_) {
+        if (def.kind != PhiDef::Kind::Residue || def.same_as_prev) continue;
+        if (read_to_phi_conc_offset_.find(read) !=
+            read_to_phi_conc_offset_.end())
+            continue;
+
+        read_to_phi_conc_offset_[read] = read_to_phi_conc_.size();
+        read_to_phi_conc_.push_back(encodePhiDef(def));
+        if (options_.solve_mode == SolveMode::Global)
+            s_.add(getEventPhiZ3Expr(read) == read_to_phi_conc_.back());
+    }
+
+    const PhiFoldStats& stats = phi_fold_stats_;
+    log(LOG_INFO) << "Phi folding: " << stats.reads << " reads, "
+                  << stats.true_reads << " true, " << stats.false_reads
+                  << " false, " << stats.aliased_reads << " aliased, "
+                  << read_to_phi_conc_.size() << " encoded; "
+                  << stats.folded_clauses << " of " << stats.clauses
+                  << " clauses folded\n";
+}
+
+EID CasualModel::phiRead(const z3::expr& phi) {
+    EID eid = 0;
+    Z3TermCache::Kind kind;
+    if (phi.is_const() && !phi.is_true() && !phi.is_false())
+        Z3TermCache::decode(phi.decl(), eid, kind);
+    return eid;
+}
+
+void CasualModel::encodeOnDemand(const z3::expr& phi, SolverBackend& solver) {
+    /* the phi equation of a read refers to the phi variables of the reads
+     * in its clauses and of the read before it, which go along */
+    std::vector<z3::expr> pending = {phi};
+    while (!pending.empty()) {
+        EID read = phiRead(pending.back());
+        pending.pop_back();
+        if (!read || read_to_phi_conc_offset_.count(read)) continue;
+
+        const PhiDef& def = read_to_phi_def_.at(read);
+        read_to_phi_conc_offset_[read] = read_to_phi_conc_.size();
+        read_to_phi_conc_.push_back(encodePhiDef(def));
+        solver.add(getEventPhiZ3Expr(read) == read_to_phi_conc_.back());
+        asserted_terms_++;
+
+        pending.push_back(getPhiConc(def.prev_read));
+        for (const PhiClause& clause : def.clauses) {
+            for (const Event& r : clause.phi_reads)
+                pending.push_back(getPhiConc(r));
+        }
+    }
+
+    for (; rf_asserted_ < rf_constraints_.size(); ++rf_asserted_) {
+        solver.add(rf_constraints_[rf_asserted_]);
+        asserted_terms_++;
+    }
+}
+
+bool CasualModel::restartEncoding(SolverBackend& solver,
+                                  const z3::expr_vector& base) {
+    if (!solver.reset(base)) return false;
+
+    /* the folded phi defs stay, only their terms go and are encoded again
+     * once a COP needs them */
+    read_to_phi_conc_offset_.clear();
+    read_to_phi_conc_.resize(0);
+    rf_constraints_.resize(0);
+    rf_asserted_ = 0;
+    asserted_terms_ = 0;
+    encoding_restarts_++;
+    return true;
+}
+
+z3::expr CasualModel::makeRFClause(const Event& read, const Event& source,
+                                   z3::expr_vector& rfConstraints,
+                                   const std::vector<Event>& badWrites) {
+    if (options_.rf_encoding == RFEncoding::Pairwise) {
+        for (const Event& badWrite : badWrites) {
+            if (hb(badWrite, source)) continue;
+
+            rfConstraints.push_back(makeRFConstraint(read, source, badWrite));
+        }
+        return z3::mk_and(rfConstraints);
     }
 
-    if (maintainReadValConstraints.size() > 0)
-        return z3::mk_or(maintainReadValConstraints);
+    /* selector encoding: the clause only pins the source of the read, the
+     * bad writes are constrained once per read against that source */
+    if (rf_source_offset_.find(read.getEventId()) == rf_source_offset_.end()) {
+        rf_source_offset_[read.getEventId()] = rf_sources_.size();
+        rf_sources_.push_back(c_.int_const(
+            ("rf_" + std::to_string(read.getEventId())).c_str()));
+    }
 
-    return c_.bool_val(true);
+    z3::expr selector = c_.bool_const(("rfs_" +
+                                       std::to_string(read.getEventId()) +
+                                       "_" + std::to_string(source.getEventId()))
+                                          .c_str());
+    rfConstraints.push_back(getRFSourceZ3Expr(read) ==
+                            getEventOrderZ3Expr(source));
+    rf_constraints_.push_back(z3::implies(selector, z3::mk_and(rfConstraints)));
+
+    return selector;
 }
 
 uint32_t CasualModel::solve(uint32_t maxCOPCheck, uint32_t maxRaceCheck) {
+    if (options_.cop_order == COPOrder::Cost) prioritizeCOPs();
+    if (options_.sample_size) return solveSample();
+    return solveTiers(maxCOPCheck, maxRaceCheck);
+}
+
+uint32_t CasualModel::solveSample() {
+    LOG_INIT_COUT();
+    COPSampler sampler(trace_.getAllEvents().size(), options_.sample_regions,
+                       options_.sample_seed);
+
+    std::vector<std::pair<Event, Event>> sample;
+    for (size_t i : sampler.draw(filtered_cop_events_, options_.sample_size))
+        sample.push_back(filtered_cop_events_[i]);
+    size_t population = filtered_cop_events_.size();
+    filtered_cop_events_ = sample;
+
+    log(LOG_INFO) << "Sampled " << sample.size() << " of " << population
+                  << " COPs from " << sampler.getStrataCount()
+                  << " strata (seed " << options_.sample_seed << ")\n";
+    uint32_t race_count = solveTiers(0, 0);
+
+    std::set<std::pair<EID, EID>> races;
+    for (const auto& [e1, e2] : races_)
+        races.insert({e1.getEventId(), e2.getEventId()});
+    std::vector<uint8_t> isRace;
+    std::set<uint32_t> variables;
+    for (const auto& [e1, e2] : sample) {
+        isRace.push_back(races.count({e1.getEventId(), e2.getEventId()}));
+        variables.insert(e1.getTargetId());
+    }
+
+    auto report = [&](const std::string& label,
+                      const COPSampler::Estimate& estimate) {
+        std::ostringstream rates;
+        rates << std::fixed << std::setprecision(3) << estimate.rate
+              << " (95% CI " << estimate.low << " to " << estimate.high << ")";
+        log(LOG_INFO) << label << ": race rate " << rates.str() << ", "
+                      << estimate.races << " races in " << estimate.sampled
+                      << " sampled of " << estimate.cops << " COPs, about "
+                      << std::llround(estimate.rate * estimate.cops)
+                      << " races (" << std::llround(estimate.low * estimate.cops)
+                      << " to " << std::llround(estimate.high * estimate.cops)
+                      << ")\n";
+    };
+    COPSampler::Estimate total = sampler.estimate(isRace);
+    report("Sample estimate", total);
+    if (total.left_out)
+        log(LOG_WARN) << total.left_out
+                      << " COPs are in strata the sample did not reach and "
+                         "are not estimated\n";
+    for (uint32_t variable : variables)
+        report("Sample estimate for variable " + std::to_string(variable),
+               sampler.estimate(isRace, variable));
+
+    return race_count;
+}
+
+uint32_t CasualModel::solveTiers(uint32_t maxCOPCheck, uint32_t maxRaceCheck) {
+    if (!options_.shb_tier && !options_.greedy_schedules &&
+        !options_.saturation)
+        return solveCOPs(maxCOPCheck, maxRaceCheck);
+
+    LOG_INIT_COUT();
+    std::optional<SHBClocks> shb;
+    if (options_.shb_tier) shb.emplace(trace_);
+    std::optional<SaturationEngine> saturation;
+    if (options_.saturation) saturation.emplace(trace_, mhb_edges_, lock_pairs_);
+    std::optional<GreedyScheduler> greedy;
+    std::optional<WitnessChecker> checker;
+    if (options_.greedy_schedules) {
+        greedy.emplace(trace_);
+        checker.emplace(trace_, false);
+    }
+
+    size_t copCount = filtered_cop_events_.size();
+    if (maxCOPCheck) copCount = std::min<size_t>(copCount, maxCOPCheck);
+
+    /* races proven without a solver are recorded right away, COPs refuted
+     * by saturation are dropped and the rest goes to Z3 */
     uint32_t race_count = 0;
+    uint64_t shb_races = 0, greedy_races = 0, rejected_schedules = 0;
+    uint64_t refuted = 0;
+    std::vector<std::pair<Event, Event>> remaining;
+    std::vector<uint32_t> witness;
+
+    for (size_t i = 0; i < filtered_cop_events_.size(); ++i) {
+        const auto& [e1, e2] = filtered_cop_events_[i];
+        bool proven = false;
+
+        if (i < copCount && !(maxRaceCheck && race_count >= maxRaceCheck)) {
+            if (shb && shb->isRace(e1, e2)) {
+                proven = true;
+                shb_races++;
+                if (options_.log_witness) witness = shb->witness(e1, e2);
+            } else if (saturation && saturation->refutes(e1, e2)) {
+                refuted++;
+                continue;
+            } else if (greedy && greedy->schedule(e1, e2, witness)) {
+                /* a schedule is only trusted once the checker accepts it */
+                proven = checker->check(witness);
+                if (proven)
+                    greedy_races++;
+                else
+                    rejected_schedules++;
+            }
+        }
+
+        if (!proven) {
+            remaining.push_back({e1, e2});
+            continue;
+        }
+
+        race_count++;
+        recordRace(e1, e2);
+        if (options_.log_witness) logger_.logWitness(witness, e1, e2);
+    }
+
+    if (saturation)
+        log(LOG_INFO) << "Saturation refuted " << refuted << " of "
+                      << saturation->getStats().cops
+                      << " COPs, solver calls avoided ("
+                      << saturation->getStats().derived_edges
+                      << " edges derived in "
+                      << saturation->getStats().rounds << " rounds)\n";
+
+    uint32_t solver_races = 0;
+    size_t settled = race_count + refuted;
+    if (!(maxRaceCheck && race_count >= maxRaceCheck) &&
+        !(maxCOPCheck && copCount == settled)) {
+        filtered_cop_events_ = std::move(remaining);
+        solver_races = solveCOPs(
+            maxCOPCheck ? static_cast<uint32_t>(copCount - settled) : 0,
+            maxRaceCheck ? maxRaceCheck - race_count : 0);
+    }
+
+    log(LOG_INFO) << "Races by path: " << shb_races << " SHB, " << greedy_races
+                  << " greedy schedules (" << rejected_schedules
+                  << " rejected by the witness check), " << solver_races
+                  << " Z3\n";
+
+    return race_count + solver_races;
+}
+
+unsigned CasualModel::remainingBudget() const {
+    if (!options_.time_budget) return UINT_MAX;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - start_time_)
+                       .count();
+    if (elapsed >= options_.time_budget) return 0;
+    return options_.time_budget - static_cast<unsigned>(elapsed);
+}
+
+std::vector<Z3Config> CasualModel::portfolioConfigs() const {
+    LOG_INIT_COUT();
+
+    std::vector<Z3Config> configs = {findZ3Config(options_.z3_config)};
+    for (const Z3Config& config : getZ3Configs()) {
+        if (configs.size() >= options_.portfolio_size) break;
+        if (config.name != configs[0].name) configs.push_back(config);
+    }
+
+    if (configs.size() < options_.portfolio_size)
+        log(LOG_WARN) << "Only " << configs.size()
+                      << " Z3 configurations to race\n";
+    return configs;
+}
+
+uint32_t CasualModel::solveCOPs(uint32_t maxCOPCheck, uint32_t maxRaceCheck) {
     LOG_INIT_COUT();
 
+    /* the solver holds the MHB and lock constraints, the phi defs of each
+     * block of COPs are built and asserted right before it is checked */
+    bool onDemand = options_.encode_on_demand &&
+                    options_.solve_mode == SolveMode::Global &&
+                    options_.solver == SolverKind::Z3 &&
+                    options_.worker_processes == 0 &&
+                    options_.solver_threads <= 1 && options_.batch_size <= 1;
+    if (options_.solver != SolverKind::Z3 &&
+        options_.solve_mode == SolveMode::Sliced)
+        log(LOG_WARN) << "The sliced solve mode only runs on Z3, --solver "
+                         "is ignored\n";
+    if (options_.encode_on_demand && !onDemand)
+        log(LOG_WARN) << "On-demand encoding needs the global solve mode on "
+                         "one Z3 solver, encoding upfront\n";
+    if (onDemand) {
+        z3::expr_vector base = s_.assertions();
+        if (options_.portfolio_size > 1) {
+            backend_ =
+                std::make_unique<PortfolioBackend>(c_, portfolioConfigs());
+            backend_->add(base);
+        } else {
+            backend_ = std::make_unique<Z3Backend>(s_);
+        }
+        uint32_t race_count = solveWithCores(z3::expr_vector(c_), maxCOPCheck,
+                                             maxRaceCheck, &base);
+
+        log(LOG_INFO) << "On-demand encoding: " << read_to_phi_def_.size()
+                      << " phi defs built, " << read_to_phi_conc_.size()
+                      << " held by the solver at the end, "
+                      << encoding_restarts_
+                      << " restarts from the base constraints\n";
+        log(LOG_INFO) << "COPs refuted by phi folding: "
+                      << phi_fold_stats_.refuted_cops << "\n";
+        return race_count;
+    }
+
     z3::expr_vector race_constraints(c_);
 
     for (const auto& [e1, e2] : filtered_cop_events_) {
-        z3::expr e1_expr = var_map_[getEventIdx(e1)];
-        z3::expr e2_expr = var_map_[getEventIdx(e2)];
+        z3::expr e1_expr = getEventOrderZ3Expr(e1);
+        z3::expr e2_expr = getEventOrderZ3Expr(e2);
+
+        z3::expr phiAbs1 = getPhiAbs(e1);
+        z3::expr phiAbs2 = getPhiAbs(e2);
+
+        if (phiAbs1.is_false() || phiAbs2.is_false()) {
+            phi_fold_stats_.refuted_cops++;
+            race_constraints.push_back(c_.bool_val(false));
+            continue;
+        }
 
-        race_constraints.push_back((e1_expr == e2_expr) & getPhiAbs(e1) &
-                                   getPhiAbs(e2));
+        race_constraints.push_back((e1_expr == e2_expr) & phiAbs1 & phiAbs2);
     }
 
-    for (const auto& [read, phiConcOffset] : read_to_phi_conc_offset_) {
-        s_.add(getEventPhiZ3Expr(read) == read_to_phi_conc_[phiConcOffset]);
+    if (options_.solve_mode != SolveMode::Sliced) encodePhiDefs();
+    log(LOG_INFO) << "COPs refuted by phi folding: "
+                  << phi_fold_stats_.refuted_cops << "\n";
+
+    if (options_.solve_mode == SolveMode::Sliced)
+        return solveSliced(race_constraints, maxCOPCheck, maxRaceCheck);
+
+    s_.add(rf_constraints_);
+    if (options_.rf_encoding == RFEncoding::Selector)
+        log(LOG_INFO) << "RF selector constraints: " << rf_constraints_.size()
+                      << "\n";
+
+    /* the other backends get the whole formula whatever the solve mode:
+     * in lazy mode s_ holds neither the lock constraints nor the phi defs */
+    if (options_.solver != SolverKind::Z3) {
+        if (options_.solver == SolverKind::DiffLogic)
+            backend_ = std::make_unique<DiffLogicBackend>(c_);
+        else
+            backend_ = std::make_unique<SmtLibBackend>(
+                c_, options_.smt_solver, options_.smt_batch,
+                options_.smt_dir);
+        backend_->add(mhb_constraints_);
+        backend_->add(lock_constraints_);
+
+        std::vector<EID> phiReads(read_to_phi_conc_.size());
+        for (const auto& [read, offset] : read_to_phi_conc_offset_)
+            phiReads[offset] = read;
+        for (size_t i = 0; i < phiReads.size(); ++i)
+            backend_->add(getEventPhiZ3Expr(phiReads[i]) ==
+                          read_to_phi_conc_[static_cast<int>(i)]);
+
+        backend_->add(rf_constraints_);
+        return solveWithCores(race_constraints, maxCOPCheck, maxRaceCheck);
+    }
+    if (options_.solve_mode == SolveMode::Lazy)
+        return solveLazy(race_constraints, maxCOPCheck, maxRaceCheck);
+    if (options_.worker_processes > 0)
+        return solveProcesses(race_constraints, maxCOPCheck, maxRaceCheck);
+    if (options_.solver_threads > 1)
+        return solveParallel(race_constraints, maxCOPCheck, maxRaceCheck);
+
+    if (options_.batch_size > 1)
+        return solveBatched(race_constraints, maxCOPCheck, maxRaceCheck);
+
+    if (options_.portfolio_size > 1) {
+        backend_ = std::make_unique<PortfolioBackend>(c_, portfolioConfigs());
+        backend_->add(s_.assertions());
+    } else {
+        backend_ = std::make_unique<Z3Backend>(s_);
     }
+    return solveWithCores(race_constraints, maxCOPCheck, maxRaceCheck);
+}
 
-    size_t i = 0;
+void CasualModel::learnOrderFact(const z3::expr_vector& core, const Event& e1,
+                                 const Event& e2, const z3::expr& notAfter,
+                                 const z3::expr& notBefore) {
+    bool le = false, ge = false;
+    for (const z3::expr& lit : core) {
+        le |= z3::eq(lit, notAfter);
+        ge |= z3::eq(lit, notBefore);
+    }
 
-    for (const auto& race_con : race_constraints) {
-        if (maxCOPCheck && i >= maxCOPCheck) break;
+    /* with both halves in the core the two events just cannot meet, which
+     * says nothing about other COPs */
+    if (le == ge) return;
 
-        z3::expr_vector race_sat(c_);
-        race_sat.push_back(race_con);
+    /* e1 <= e2 is refuted, so e2 comes first */
+    Event r1 = trace_.getPrevReadInThread(e1);
+    Event r2 = trace_.getPrevReadInThread(e2);
+    OrderFact fact = le ? OrderFact{e2, e1, r2, r1} : OrderFact{e1, e2, r1, r2};
+
+    order_facts_[threadPairKey(fact.first.getThreadId(),
+                               fact.second.getThreadId())]
+        .push_back(fact);
+    order_fact_count_++;
+}
+
+bool CasualModel::refutedByFacts(const Event& e1, const Event& e2) {
+    Event r1 = trace_.getPrevReadInThread(e1);
+    Event r2 = trace_.getPrevReadInThread(e2);
+
+    /* phi of a read implies the phi of every read before it in its thread */
+    auto implied = [&r1, &r2](const Event& read) {
+        if (Event::isNullEvent(read)) return true;
+        for (const Event& r : {r1, r2}) {
+            if (!Event::isNullEvent(r) &&
+                r.getThreadId() == read.getThreadId() &&
+                read.getEventId() <= r.getEventId())
+                return true;
+        }
+        return false;
+    };
+
+    /* x at or before first and y at or after second in program order puts
+     * x strictly before y, so the two cannot meet */
+    auto refutes = [&](const Event& x, const Event& y) {
+        auto facts = order_facts_.find(
+            threadPairKey(x.getThreadId(), y.getThreadId()));
+        if (facts == order_facts_.end()) return false;
+
+        for (const OrderFact& fact : facts->second) {
+            if (x.getEventId() <= fact.first.getEventId() &&
+                fact.second.getEventId() <= y.getEventId() &&
+                implied(fact.first_read) && implied(fact.second_read))
+                return true;
+        }
+        return false;
+    };
+
+    return refutes(e1, e2) || refutes(e2, e1);
+}
+
+z3::expr_vector CasualModel::makeRaceQuery(const Event& e1, const Event& e2) {
+    const z3::expr& o1 = getEventOrderZ3Expr(e1);
+    const z3::expr& o2 = getEventOrderZ3Expr(e2);
+    z3::expr phis = getPhiAbs(e1) && getPhiAbs(e2);
+
+    /* with cores the query is checked as two assumptions, one per side of
+     * the equality, so the core tells whether the refutation only needs
+     * one of them */
+    z3::expr_vector assumptions(c_);
+    if (options_.unsat_cores) {
+        assumptions.push_back((o1 <= o2) && phis);
+        assumptions.push_back((o2 <= o1) && phis);
+    } else {
+        assumptions.push_back((o1 == o2) && phis);
+    }
+    return assumptions;
+}
+
+void CasualModel::readModelValues(const z3::model& m) {
+    size_t size = trace_.getAllEvents().size() + 1;
+    model_order_.assign(size, 0);
+    model_order_known_.assign(size, 0);
+    model_phi_true_.assign(size, 0);
+
+    for (unsigned i = 0; i < m.size(); ++i) {
+        z3::func_decl v = m[static_cast<int>(i)];
+
+        EID eid;
+        Z3TermCache::Kind kind;
+        if (!Z3TermCache::decode(v, eid, kind) || eid >= size) continue;
+
+        z3::expr value = m.get_const_interp(v);
+        if (kind == Z3TermCache::Kind::Phi) {
+            model_phi_true_[eid] = value.is_true();
+        } else {
+            model_order_[eid] = value.get_numeral_int64();
+            model_order_known_[eid] = 1;
+        }
+    }
+}
+
+uint64_t CasualModel::confirmFromModel(
+    const z3::model& m, const std::vector<uint8_t>& ready,
+    const std::vector<std::pair<EID, EID>>& copPhis, size_t begin, size_t end,
+    std::vector<uint8_t>& confirmed,
+    std::vector<std::vector<uint32_t>>& witnesses) {
+    /* only the variables of the COPs looked at are read from the model, so
+     * a confirmation costs the same on any trace size */
+    auto order = [&m, this](const Event& e, int64_t& value) {
+        return m.eval(getEventOrderZ3Expr(e), false).is_numeral_i64(value);
+    };
+
+    /* a phi_abs that folded to true has no variable (EID 0). The value of
+     * a phi variable whose equation the solver does not hold means nothing */
+    auto holds = [&m, this](EID phi) {
+        return phi == 0 || (read_to_phi_conc_offset_.count(phi) &&
+                            m.eval(getEventPhiZ3Expr(phi), false).is_true());
+    };
+
+    uint64_t count = 0;
+    for (size_t j = begin; j < end; ++j) {
+        if (confirmed[j] || !ready[j]) continue;
+
+        auto [e1, e2] = filtered_cop_events_[j];
+        int64_t o1, o2;
+        if (!order(e1, o1) || !order(e2, o2) || o1 != o2 ||
+            !holds(copPhis[j].first) || !holds(copPhis[j].second))
+            continue;
+
+        confirmed[j] = 1;
+        if (options_.log_witness)
+            witnesses[j] = logger_.witnessFromModel(m, e1, e2);
+        count++;
+    }
+
+    return count;
+}
+
+uint32_t CasualModel::solveWithCores(const z3::expr_vector& raceConstraints,
+                                     uint32_t maxCOPCheck,
+                                     uint32_t maxRaceCheck,
+                                     const z3::expr_vector* base) {
+    LOG_INIT_COUT();
+    SolverBackend& solver = *backend_;
+    uint32_t race_count = 0;
+    uint64_t checks = 0, confirmed_count = 0, unknown_count = 0;
+
+    bool onDemand = base != nullptr;
+    size_t copCount =
+        onDemand ? filtered_cop_events_.size() : raceConstraints.size();
+    if (maxCOPCheck) copCount = std::min<size_t>(copCount, maxCOPCheck);
+
+    /* phi variable of each side's phi_abs, 0 where it folded to true. A COP
+     * is ready once they are known, on demand right before its check */
+    std::vector<std::pair<EID, EID>> copPhis(copCount);
+    std::vector<uint8_t> ready(copCount, 0), refuted(copCount, 0);
+    auto prepare = [&](size_t i) {
+        z3::expr phi1 = getPhiAbs(filtered_cop_events_[i].first);
+        z3::expr phi2 = getPhiAbs(filtered_cop_events_[i].second);
+        if (phi1.is_false() || phi2.is_false()) {
+            refuted[i] = 1;
+            phi_fold_stats_.refuted_cops += onDemand;
+            return;
+        }
+        copPhis[i] = {phiRead(phi1), phiRead(phi2)};
+        ready[i] = 1;
+    };
+    for (size_t i = 0; i < copCount && !onDemand; ++i) {
+        if (raceConstraints[i].is_false())
+            refuted[i] = 1;
+        else
+            prepare(i);
+    }
+
+    /* the solver starts over from the base once the terms asserted since it
+     * last did pass the limit. The limit is at least twice what the first
+     * block after a restart takes, so a block that needs more than the
+     * budget on its own does not restart it every time */
+    uint64_t termLimit = options_.term_budget;
+    bool restarted = false;
+
+    /* a COP whose phi defs were built for earlier ones is prepared without
+     * building any, so that models can confirm it */
+    auto built = [this](const Event& e) {
+        Event read = trace_.getPrevReadInThread(e);
+        return Event::isNullEvent(read) ||
+               read_to_phi_def_.count(read.getEventId());
+    };
+
+    /* COPs already satisfied by the model of an earlier race */
+    std::vector<uint8_t> confirmed(copCount, 0);
+    std::vector<std::vector<uint32_t>> witnesses(copCount);
+
+    size_t batchSize = solver.getBatchSize();
+    std::vector<size_t> block;
+    std::vector<z3::expr_vector> queries;
+    bool done = false;
+
+    /* COPs whose check ran out of its slice go to the back of the queue and
+     * get a slice four times as large once the cheaper ones are through */
+    std::vector<size_t> order(copCount), deferred;
+    for (size_t i = 0; i < copCount; ++i) order[i] = i;
+    unsigned slice = options_.cop_timeout;
+    uint64_t sat_count = 0, unsat_count = 0, deferred_count = 0;
+    uint64_t late_answers = 0, pruned_before = core_pruned_cops_;
+    uint64_t unreached = 0;
+
+    /* once the time budget is spent the rest of the COPs is still walked,
+     * so that the ones confirmed by earlier models are reported, but none
+     * of them is checked any more */
+    bool expired = false;
+
+    for (unsigned round = 0; !order.empty() && !done; ++round) {
+        bool retry = slice && round < options_.cop_retries;
+        deferred.clear();
+
+        for (size_t begin = 0; begin < order.size() && !done;) {
+            unsigned budget = expired ? 0 : remainingBudget();
+            expired = !budget;
+            if (!expired && (slice || options_.time_budget))
+                solver.setTimeout(slice ? std::min(slice, budget) : budget);
+            if (onDemand && termLimit && asserted_terms_ > termLimit)
+                restarted = restartEncoding(solver, *base);
+
+            /* the next COPs that still need the solver, then their answers
+             * in COP order together with the COPs confirmed in between */
+            block.clear();
+            queries.clear();
+            size_t end = begin;
+            for (; end < order.size() && block.size() < batchSize; ++end) {
+                size_t i = order[end];
+                if (onDemand && !ready[i] && !refuted[i]) prepare(i);
+                if (refuted[i] || confirmed[i]) continue;
+
+                auto [e1, e2] = filtered_cop_events_[i];
+                if (options_.unsat_cores && refutedByFacts(e1, e2)) {
+                    core_pruned_cops_++;
+                    continue;
+                }
+                if (expired) {
+                    unreached++;
+                    continue;
+                }
+                block.push_back(end);
+                queries.push_back(makeRaceQuery(e1, e2));
+            }
+
+            for (size_t k = 0; k < block.size() && onDemand; ++k) {
+                auto [e1, e2] = filtered_cop_events_[order[block[k]]];
+                encodeOnDemand(getPhiAbs(e1), solver);
+                encodeOnDemand(getPhiAbs(e2), solver);
+            }
+            if (restarted && !block.empty()) {
+                termLimit = std::max<uint64_t>(termLimit, 2 * asserted_terms_);
+                restarted = false;
+            }
+
+            checks += queries.size();
+            std::vector<SolverBackend::Answer> answers =
+                queries.empty() ? std::vector<SolverBackend::Answer>()
+                                : solver.checkBatch(queries);
+
+            size_t next = 0;
+            for (size_t k = begin; k < end && !done; ++k) {
+                bool queried = next < block.size() && block[next] == k;
+                size_t slot = next;
+                if (queried) next++;
+
+                size_t i = order[k];
+                auto [e1, e2] = filtered_cop_events_[i];
+                if (confirmed[i]) {
+                    race_count++;
+                    sat_count++;
+                    recordRace(e1, e2);
+                    if (options_.log_witness)
+                        logger_.logWitness(witnesses[i], e1, e2);
+                    witnesses[i].clear();
+
+                    done = maxRaceCheck && race_count >= maxRaceCheck;
+                    continue;
+                }
+                if (!queried) continue;
+
+                /* settled COPs are marked confirmed too, so that the models
+                 * of the retries do not count them again */
+                SolverBackend::Answer& answer = answers[slot];
+                if (answer.result == SolverBackend::Result::Sat) {
+                    race_count++;
+                    sat_count++;
+                    late_answers += round > 0;
+                    recordRace(e1, e2);
+                    confirmed[i] = 1;
+                    done = maxRaceCheck && race_count >= maxRaceCheck;
+                    if (!answer.model) continue;
+
+                    if (options_.log_witness)
+                        logger_.logWitnessPrefix(*answer.model, e1, e2);
+                    if (done) continue;
+
+                    /* a model only confirms COPs close behind the race, so a
+                     * SAT answer does not cost a walk over all the rest */
+                    size_t window = std::min<size_t>(
+                        copCount, i + 1 + options_.confirm_window);
+                    for (size_t j = i + 1; j < window && onDemand; ++j) {
+                        if (!ready[j] && !refuted[j] &&
+                            built(filtered_cop_events_[j].first) &&
+                            built(filtered_cop_events_[j].second))
+                            prepare(j);
+                    }
+                    confirmed_count +=
+                        confirmFromModel(*answer.model, ready, copPhis, i + 1,
+                                         window, confirmed, witnesses);
+                } else if (answer.result == SolverBackend::Result::Unsat) {
+                    unsat_count++;
+                    late_answers += round > 0;
+                    confirmed[i] = 1;
+                    if (!options_.unsat_cores) continue;
+
+                    const z3::expr_vector& query = queries[slot];
+                    z3::expr_vector core(c_);
+                    for (size_t idx : answer.core) core.push_back(query[idx]);
+                    learnOrderFact(core, e1, e2, query[0], query[1]);
+                } else if (retry) {
+                    deferred.push_back(i);
+                    deferred_count += round == 0;
+                } else {
+                    unknown_count++;
+                }
+            }
+
+            begin = end;
+        }
+
+        order.swap(deferred);
+        slice *= 4;
+    }
+    if (slice || options_.time_budget) solver.setTimeout(0);
+
+    solver.logStats();
+    if (options_.unsat_cores)
+        log(LOG_INFO) << "COPs pruned by unsat cores: " << core_pruned_cops_
+                      << " (" << order_fact_count_ << " order facts learned, "
+                      << checks << " solver calls)\n";
+    log(LOG_INFO) << "COPs confirmed by earlier models: " << confirmed_count
+                  << "\n";
+    if (options_.cop_timeout || options_.time_budget) {
+        uint64_t unchecked = core_pruned_cops_ - pruned_before;
+        for (size_t i = 0; i < copCount; ++i) unchecked += refuted[i];
+        log(LOG_INFO) << "COP results: " << sat_count << " SAT, "
+                      << unsat_count + unchecked << " UNSAT (" << unchecked
+                      << " without a check), " << unknown_count + unreached
+                      << " unknown (" << unreached
+                      << " not reached in the time budget); " << deferred_count
+                      << " deferred, " << late_answers
+                      << " answered on a retry\n";
+    }
+    if (unknown_count)
+        log(LOG_WARN) << "COPs left unknown by the solver: " << unknown_count
+                      << "\n";
+
+    return race_count;
+}
+
+uint64_t CasualModel::refineLazy(const z3::model& m) {
+    readModelValues(m);
+
+    auto before = [this](const Event& e1, const Event& e2) {
+        return model_order_[e1.getEventId()] < model_order_[e2.getEventId()];
+    };
+
+    uint64_t added = 0;
+    for (size_t k = 0; k < lock_pairs_.size(); ++k) {
+        if (lazy_lock_added_[k]) continue;
+
+        /* exactly one of the regions has to end before the other starts */
+        const auto& [lr1, lr2] = lock_pairs_[k];
+        if (before(lr1.getRelEvent(), lr2.getAcqEvent()) !=
+            before(lr2.getRelEvent(), lr1.getAcqEvent()))
+            continue;
+
+        s_.add(lock_constraints_[k]);
+        lazy_lock_added_[k] = 1;
+        added++;
+    }
+
+    /* a phi set to false only weakens the query, so just the ones the
+     * model claims to hold need their read values checked */
+    for (const auto& [read, offset] : read_to_phi_conc_offset_) {
+        if (lazy_phi_added_[offset] || !model_phi_true_[read]) continue;
+        if (!m.eval(read_to_phi_conc_[offset], true).is_false()) continue;
+
+        s_.add(getEventPhiZ3Expr(read) == read_to_phi_conc_[offset]);
+        lazy_phi_added_[offset] = 1;
+        added++;
+    }
+
+    return added;
+}
+
+uint32_t CasualModel::solveLazy(const z3::expr_vector& raceConstraints,
+                                uint32_t maxCOPCheck, uint32_t maxRaceCheck) {
+    LOG_INIT_COUT();
+    uint32_t race_count = 0;
+    uint64_t checks = 0, refinements = 0;
+
+    lazy_lock_added_.assign(lock_constraints_.size(), 0);
+    lazy_phi_added_.assign(read_to_phi_conc_.size(), 0);
+
+    size_t copCount = raceConstraints.size();
+    if (maxCOPCheck) copCount = std::min<size_t>(copCount, maxCOPCheck);
+
+    for (size_t i = 0; i < copCount; ++i) {
+        if (raceConstraints[i].is_false()) continue;
 
         auto [e1, e2] = filtered_cop_events_[i];
+        if (options_.unsat_cores && refutedByFacts(e1, e2)) {
+            core_pruned_cops_++;
+            continue;
+        }
+
+        z3::expr_vector assumptions = makeRaceQuery(e1, e2);
+
+        /* constraints only ever get added, so an unsat answer and the facts
+         * learned from it hold for the full formula too */
+        while (true) {
+            checks++;
+            if (s_.check(assumptions) != z3::sat) {
+                if (options_.unsat_cores)
+                    learnOrderFact(s_.unsat_core(), e1, e2, assumptions[0],
+                                   assumptions[1]);
+                break;
+            }
+
+            z3::model m = s_.get_model();
+            if (refineLazy(m) > 0) {
+                refinements++;
+                continue;
+            }
 
-        if (s_.check(race_sat) == z3::sat) {
             race_count++;
-            if (log_witness_) {
-                logger_.logWitnessPrefix(s_.get_model(), e1, e2);
+            recordRace(e1, e2);
+            if (options_.log_witness) logger_.logWitnessPrefix(m, e1, e2);
+            break;
+        }
+
+        if (maxRaceCheck && race_count >= maxRaceCheck) break;
+    }
+
+    log(LOG_INFO) << "Lazy solving: " << checks << " solver calls, "
+                  << refinements << " refinements, "
+                  << std::count(lazy_lock_added_.begin(),
+                                lazy_lock_added_.end(), 1)
+                  << " of " << lazy_lock_added_.size()
+                  << " lock constraints and "
+                  << std::count(lazy_phi_added_.begin(),
+                                lazy_phi_added_.end(), 1)
+                  << " of " << lazy_phi_added_.size()
+                  << " phi equations added\n";
+    if (options_.unsat_cores)
+        log(LOG_INFO) << "COPs pruned by unsat cores: " << core_pruned_cops_
+                      << " (" << order_fact_count_
+                      << " order facts learned)\n";
+
+    return race_count;
+}
+
+uint32_t CasualModel::solveParallel(const z3::expr_vector& raceConstraints,
+                                   uint32_t maxCOPCheck,
+                                   uint32_t maxRaceCheck) {
+    LOG_INIT_COUT();
+
+    size_t copCount = raceConstraints.size();
+    if (maxCOPCheck) copCount = std::min<size_t>(copCount, maxCOPCheck);
+
+    unsigned workerCount = options_.solver_threads;
+    WorkStealingQueue<size_t> queue(workerCount);
+
+    /* contiguous blocks keep neighbouring COPs, which share most of their
+     * constraints, on the same solver */
+    for (size_t i = 0; i < copCount; ++i) {
+        if (raceConstraints[i].is_false()) continue;
+        queue.push(i * workerCount / copCount, i);
+    }
+
+    /* every use of c_ from a worker, including reference counting of its
+     * terms, goes through this mutex */
+    std::mutex source_mutex;
+    z3::expr_vector base = s_.assertions();
+
+    std::vector<uint8_t> sat(copCount, 0);
+    std::vector<std::vector<uint32_t>> witnesses(copCount);
+    std::vector<uint64_t> checks(workerCount, 0);
+    std::atomic<uint32_t> found{0};
+    std::atomic<bool> stop{false};
+    std::vector<std::exception_ptr> errors(workerCount);
+
+    auto work = [&](unsigned w) {
+        try {
+            z3::context c;
+            z3::solver s(c, "QF_IDL");
+            applyZ3Config(s, findZ3Config(options_.z3_config));
+
+            {
+                std::lock_guard<std::mutex> guard(source_mutex);
+                s.add(z3::expr_vector(c, base));
+            }
+
+            size_t i;
+            while (!stop && queue.pop(w, i)) {
+                z3::expr_vector race_sat(c);
+                {
+                    std::lock_guard<std::mutex> guard(source_mutex);
+                    z3::expr race = raceConstraints[static_cast<int>(i)];
+                    race_sat.push_back(
+                        z3::to_expr(c, Z3_translate(c_, race, c)));
+                }
+
+                checks[w]++;
+                if (s.check(race_sat) != z3::sat) continue;
+
+                sat[i] = 1;
+                noteFirstRace();
+                if (options_.log_witness) {
+                    const auto& [e1, e2] = filtered_cop_events_[i];
+                    witnesses[i] = logger_.witnessFromModel(s.get_model(), e1, e2);
+                }
+
+                if (maxRaceCheck && ++found >= maxRaceCheck) stop = true;
+            }
+        } catch (...) {
+            errors[w] = std::current_exception();
+            stop = true;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < workerCount; ++w) workers.emplace_back(work, w);
+    for (std::thread& worker : workers) worker.join();
+
+    for (const std::exception_ptr& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+
+    /* merge in COP order so the races and witnesses do not depend on the
+     * scheduling of the workers */
+    uint32_t race_count = 0;
+    for (size_t i = 0; i < copCount; ++i) {
+        if (!sat[i]) continue;
+
+        const auto& [e1, e2] = filtered_cop_events_[i];
+        race_count++;
+        recordRace(e1, e2);
+        if (options_.log_witness) logger_.logWitness(witnesses[i], e1, e2);
+
+        if (maxRaceCheck && race_count >= maxRaceCheck) break;
+    }
+
+    std::ostringstream perWorker;
+    for (uint64_t count : checks) perWorker << " " << count;
+    log(LOG_INFO) << "Parallel solving: " << workerCount
+                  << " workers, checks per worker:" << perWorker.str() << "\n";
+
+    return race_count;
+}
+
+void CasualModel::runShardWorker(const z3::expr_vector& raceConstraints,
+                                 int taskFd, int resultFd) {
+    ShardChannel::Message message;
+    message.type = ShardChannel::Ready;
+    if (!ShardChannel::sendMessage(resultFd, message)) return;
+
+    uint64_t begin, end;
+    while (ShardChannel::receiveShard(taskFd, begin, end) && begin < end) {
+        for (uint64_t i = begin; i < end; ++i) {
+            message.type = ShardChannel::Result;
+            message.cop = static_cast<uint32_t>(i);
+            message.sat = false;
+            message.witness.clear();
+
+            z3::expr race = raceConstraints[static_cast<int>(i)];
+            if (!race.is_false()) {
+                z3::expr_vector race_sat(c_);
+                race_sat.push_back(race);
+                message.sat = s_.check(race_sat) == z3::sat;
+            }
+
+            if (message.sat && options_.log_witness) {
+                const auto& [e1, e2] = filtered_cop_events_[i];
+                message.witness =
+                    logger_.witnessFromModel(s_.get_model(), e1, e2);
             }
 
+            if (!ShardChannel::sendMessage(resultFd, message)) return;
+        }
+
+        message.type = ShardChannel::Ready;
+        message.witness.clear();
+        if (!ShardChannel::sendMessage(resultFd, message)) return;
+    }
+}
+
+uint32_t CasualModel::solveProcesses(const z3::expr_vector& raceConstraints,
+                                     uint32_t maxCOPCheck,
+                                     uint32_t maxRaceCheck) {
+    LOG_INIT_COUT();
+
+    size_t copCount = raceConstraints.size();
+    if (maxCOPCheck) copCount = std::min<size_t>(copCount, maxCOPCheck);
+    size_t shardSize = std::max(1u, options_.shard_size);
+
+    struct Worker {
+        pid_t pid;
+        int task_fd;
+        int result_fd;
+        uint64_t pending = 0;  // COPs of the current shard not reported yet
+        bool alive = true;
+    };
+
+    /* the workers are forked once the base formula is built, so the trace,
+     * its indices and the solver are shared copy on write instead of being
+     * loaded again by every worker */
+    std::cout.flush();
+    std::cerr.flush();
+
+    std::vector<Worker> workers;
+
+    /* a worker that died must not take the coordinator down with SIGPIPE.
+     * However the coordinator leaves, the guard restores SIGPIPE and reaps
+     * the workers still running, so an exception leaves no zombie behind */
+    struct ProcessGuard {
+        decltype(SIG_IGN) previous_sigpipe;
+        std::vector<Worker>& workers;
+
+        ~ProcessGuard() {
+            for (Worker& worker : workers) {
+                if (!worker.alive) continue;
+                close(worker.task_fd);
+                close(worker.result_fd);
+                kill(worker.pid, SIGKILL);
+                waitpid(worker.pid, nullptr, 0);
+            }
+            signal(SIGPIPE, previous_sigpipe);
+        }
+    } guard{signal(SIGPIPE, SIG_IGN), workers};
+
+    for (unsigned w = 0; w < options_.worker_processes; ++w) {
+        int task[2], result[2];
+        if (pipe(task) != 0)
+            throw std::runtime_error("Failed to create worker pipes");
+        if (pipe(result) != 0) {
+            close(task[0]);
+            close(task[1]);
+            throw std::runtime_error("Failed to create worker pipes");
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            for (int fd : {task[0], task[1], result[0], result[1]}) close(fd);
+            throw std::runtime_error("Failed to fork worker");
+        }
+
+        if (pid == 0) {
+            /* only keep this worker's ends, so the coordinator sees end of
+             * file on a result pipe exactly when its worker is gone */
+            for (const Worker& other : workers) {
+                close(other.task_fd);
+                close(other.result_fd);
+            }
+            close(task[1]);
+            close(result[0]);
+            try {
+                runShardWorker(raceConstraints, task[0], result[1]);
+            } catch (...) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+
+        close(task[0]);
+        close(result[1]);
+        workers.push_back({pid, task[1], result[0]});
+    }
+
+    std::vector<uint8_t> sat(copCount, 0);
+    std::vector<std::vector<uint32_t>> witnesses(copCount);
+    uint64_t next = 0, shards = 0, lost = 0, failed = 0;
+    uint32_t found = 0;
+
+    auto finish = [&](Worker& worker) {
+        close(worker.task_fd);
+        close(worker.result_fd);
+        worker.alive = false;
+
+        int status = 0;
+        waitpid(worker.pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || worker.pending) {
+            failed++;
+            lost += worker.pending;
+            log(LOG_WARN) << "Solver process " << worker.pid << " failed, "
+                          << worker.pending << " COPs of its shard lost\n";
+        }
+    };
+
+    size_t alive = workers.size();
+    while (alive > 0) {
+        std::vector<pollfd> fds;
+        std::vector<size_t> owners;
+        for (size_t w = 0; w < workers.size(); ++w) {
+            if (!workers[w].alive) continue;
+            fds.push_back({workers[w].result_fd, POLLIN, 0});
+            owners.push_back(w);
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Failed to poll solver processes");
+        }
+
+        for (size_t k = 0; k < fds.size(); ++k) {
+            if (!fds[k].revents) continue;
+            Worker& worker = workers[owners[k]];
+
+            ShardChannel::Message message;
+            if (!ShardChannel::receiveMessage(worker.result_fd, message)) {
+                finish(worker);
+                alive--;
+                continue;
+            }
+
+            if (message.type == ShardChannel::Result) {
+                worker.pending--;
+                if (message.sat && message.cop < copCount && !sat[message.cop]) {
+                    sat[message.cop] = 1;
+                    noteFirstRace();
+                    witnesses[message.cop] = std::move(message.witness);
+                    found++;
+                }
+                continue;
+            }
+
+            bool done = next >= copCount ||
+                        (maxRaceCheck && found >= maxRaceCheck);
+            uint64_t begin = done ? 0 : next;
+            uint64_t end = done ? 0 : std::min<uint64_t>(next + shardSize,
+                                                          copCount);
+            if (!ShardChannel::sendShard(worker.task_fd, begin, end)) {
+                /* the next read reports the worker as gone */
+                continue;
+            }
+            if (done) {
+                finish(worker);
+                alive--;
+                continue;
+            }
+
+            next = end;
+            worker.pending = end - begin;
+            shards++;
+        }
+    }
+
+    uint32_t race_count = 0;
+    for (size_t i = 0; i < copCount; ++i) {
+        if (!sat[i]) continue;
+
+        const auto& [e1, e2] = filtered_cop_events_[i];
+        race_count++;
+        recordRace(e1, e2);
+        if (options_.log_witness) logger_.logWitness(witnesses[i], e1, e2);
+
+        if (maxRaceCheck && race_count >= maxRaceCheck) break;
+    }
+
+    log(LOG_INFO) << "Process solving: " << workers.size() << " workers, "
+                  << shards << " shards of " << shardSize << " COPs, "
+                  << failed << " failed workers, " << lost
+                  << " COPs lost\n";
+
+    return race_count;
+}
+
+void CasualModel::extendCone(const Event& e) {
+    mhb_clocks_.joinInto(e, cone_);
+}
+
+std::vector<Event> CasualModel::computeCone(const Event& e1,
+                                            const Event& e2) {
+    size_t threadCount = mhb_clocks_.getThreadCount();
+    cone_.assign(threadCount, 0);
+    extendCone(e1);
+    extendCone(e2);
+
+    /* The cone is a prefix of every thread: the causal past of the COP,
+     * for every read whose phi the COP depends on the causal past of the
+     * sources it may read from, and the releases of the acquires inside.
+     * The reads are all reads of a thread up to the last one referenced,
+     * found along phi_abs and the phi_reads of the clauses. */
+    std::vector<uint32_t> required(threadCount, 0);
+    std::vector<Event> encoded;
+    std::vector<Event> pending = {trace_.getPrevReadInThread(e1),
+                                  trace_.getPrevReadInThread(e2)};
+
+    while (!pending.empty()) {
+        Event read = pending.back();
+        pending.pop_back();
+        if (Event::isNullEvent(read)) continue;
+
+        uint32_t t = mhb_clocks_.getThreadIdx(read.getThreadId());
+        const std::vector<Event>& reads = thread_reads_[t];
+        uint32_t last = static_cast<uint32_t>(
+            std::upper_bound(reads.begin(), reads.end(), read,
+                             [](const Event& a, const Event& b) {
+                                 return a.getEventId() < b.getEventId();
+                             }) -
+            reads.begin());
+
+        for (uint32_t k = required[t]; k < last; ++k) {
+            const PhiDef& def = buildPhiDef(reads[k]);
+            if (def.kind != PhiDef::Kind::Residue || def.same_as_prev) continue;
+
+            encoded.push_back(reads[k]);
+            for (const PhiClause& clause : def.clauses) {
+                if (!Event::isNullEvent(clause.source))
+                    extendCone(clause.source);
+                pending.insert(pending.end(), clause.phi_reads.begin(),
+                               clause.phi_reads.end());
+            }
+        }
+        required[t] = std::max(required[t], last);
+    }
+
+    /* a lock held inside the cone may be released before the COP, so the
+     * release and its causal past belong to the cone as well */
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& [lr1, lr2] : lock_pairs_) {
+            for (const LockRegion* region : {&lr1, &lr2}) {
+                const Event& rel = region->getRelEvent();
+                if (inCone(region->getAcqEvent()) && !Event::isNullEvent(rel) &&
+                    !inCone(rel)) {
+                    extendCone(rel);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    return encoded;
+}
+
+uint32_t CasualModel::solveBatched(const z3::expr_vector& raceConstraints,
+                                   uint32_t maxCOPCheck,
+                                   uint32_t maxRaceCheck) {
+    LOG_INIT_COUT();
+    size_t copCount = raceConstraints.size();
+    if (maxCOPCheck) copCount = std::min<size_t>(copCount, maxCOPCheck);
+
+    uint32_t race_count = 0;
+    uint64_t checks = 0, refuted_blocks = 0;
+
+    for (size_t begin = 0; begin < copCount; begin += options_.batch_size) {
+        size_t end = std::min<size_t>(begin + options_.batch_size, copCount);
+
+        std::vector<std::vector<size_t>> blocks(1);
+        for (size_t i = begin; i < end; ++i) {
+            if (!raceConstraints[i].is_false()) blocks[0].push_back(i);
+        }
+
+        std::vector<std::pair<size_t, std::vector<uint32_t>>> found;
+
+        while (!blocks.empty()) {
+            std::vector<size_t> block = std::move(blocks.back());
+            blocks.pop_back();
+            if (block.empty()) continue;
+
+            /* one query for the whole block: some COP in it is a race */
+            z3::expr_vector disjuncts(c_);
+            for (size_t i : block) disjuncts.push_back(raceConstraints[i]);
+
+            z3::expr_vector assumptions(c_);
+            assumptions.push_back(z3::mk_or(disjuncts));
+
+            checks++;
+            if (s_.check(assumptions) != z3::sat) {
+                refuted_blocks++;
+                continue;
+            }
+
+            /* the model decides every COP of the block it satisfies */
+            z3::model m = s_.get_model();
+            std::vector<size_t> rest;
+            for (size_t i : block) {
+                if (!m.eval(raceConstraints[i], true).is_true()) {
+                    rest.push_back(i);
+                    continue;
+                }
+
+                auto [e1, e2] = filtered_cop_events_[i];
+                found.push_back({i, options_.log_witness
+                                        ? logger_.witnessFromModel(m, e1, e2)
+                                        : std::vector<uint32_t>()});
+            }
+
+            /* split the rest, so a block with few races is refuted quickly */
+            size_t half = rest.size() / 2;
+            blocks.emplace_back(rest.begin() + half, rest.end());
+            blocks.emplace_back(rest.begin(), rest.begin() + half);
+        }
+
+        std::sort(found.begin(), found.end());
+        for (const auto& [i, witness] : found) {
+            auto [e1, e2] = filtered_cop_events_[i];
+            race_count++;
+            recordRace(e1, e2);
+            if (options_.log_witness) logger_.logWitness(witness, e1, e2);
+
             if (maxRaceCheck && race_count >= maxRaceCheck) break;
         }
 
-        i++;
+        if (maxRaceCheck && race_count >= maxRaceCheck) break;
+    }
+
+    log(LOG_INFO) << "Batched solving: blocks of " << options_.batch_size
+                  << " COPs, " << checks << " solver calls, "
+                  << refuted_blocks << " blocks refuted at once\n";
+
+    return race_count;
+}
+
+uint32_t CasualModel::solveSliced(const z3::expr_vector& raceConstraints,
+                                  uint32_t maxCOPCheck,
+                                  uint32_t maxRaceCheck) {
+    LOG_INIT_COUT();
+    uint32_t race_count = 0;
+    uint64_t solved = 0;
+    uint64_t cone_events = 0;
+    size_t event_count = trace_.getAllEvents().size();
+
+    thread_reads_.assign(mhb_clocks_.getThreadCount(), {});
+    for (const Thread& thread : trace_.getThreads()) {
+        std::vector<Event>& reads =
+            thread_reads_[mhb_clocks_.getThreadIdx(thread.getThreadId())];
+        for (const Event& e : thread.getEvents()) {
+            if (e.getEventType() == Event::EventType::Read) reads.push_back(e);
+        }
+    }
+
+    for (size_t i = 0; i < raceConstraints.size(); ++i) {
+        if (maxCOPCheck && i >= maxCOPCheck) break;
+        if (raceConstraints[i].is_false()) continue;
+
+        auto [e1, e2] = filtered_cop_events_[i];
+        std::vector<Event> reads = computeCone(e1, e2);
+
+        /* nothing global is asserted on s_ in this mode, the scope only
+         * holds the formula of the current COP */
+        s_.push();
+
+        for (const auto& [from, to] : mhb_edges_) {
+            if (inCone(from) && inCone(to)) s_.add(orderAtom(from, to));
+        }
+
+        /* a region whose acquire is outside the cone is scheduled after it,
+         * so only pairs with both acquires inside constrain the COP */
+        for (const auto& [lr1, lr2] : lock_pairs_) {
+            if (inCone(lr1.getAcqEvent()) && inCone(lr2.getAcqEvent()))
+                s_.add(makeLockConstraint(lr1, lr2));
+        }
+
+        rf_constraints_.resize(0);
+        for (const Event& read : reads) {
+            s_.add(getEventPhiZ3Expr(read) == encodePhiDef(buildPhiDef(read)));
+        }
+        s_.add(rf_constraints_);
+
+        z3::expr_vector race_sat(c_);
+        race_sat.push_back(raceConstraints[i]);
+
+        for (uint32_t bound : cone_) cone_events += bound;
+        solved++;
+
+        bool sat = s_.check(race_sat) == z3::sat;
+        if (sat) {
+            race_count++;
+            recordRace(e1, e2);
+            if (options_.log_witness) {
+                logger_.logWitnessPrefix(s_.get_model(), e1, e2);
+            }
+        }
+        s_.pop();
+
+        if (sat && maxRaceCheck && race_count >= maxRaceCheck) break;
     }
 
+    cone_.clear();
+
+    log(LOG_INFO) << "Sliced solving: " << solved << " COPs, average cone "
+                  << (solved ? cone_events / solved : 0) << " of "
+                  << event_count << " events\n";
+
     return race_count;
-}
\ No newline at end of file
+}
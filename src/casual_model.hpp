@@ -1,154 +1,377 @@
+#pragma once
+
 #include <z3++.h>
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "BSlogger.hpp"
+#include "candidate_write_engine.hpp"
+#include "cop_sampler.hpp"
+#include "cop_scheduler.hpp"
+#include "diff_logic_backend.hpp"
 #include "event.hpp"
+#include "greedy_scheduler.hpp"
+#include "lock_constraint_engine.hpp"
 #include "lockset_engine.hpp"
 #include "model_logger.hpp"
+#include "phi_formula.hpp"
+#include "portfolio_backend.hpp"
+#include "saturation_engine.hpp"
+#include "shard_channel.hpp"
+#include "shb_clocks.hpp"
+#include "smtlib_backend.hpp"
+#include "solver_backend.hpp"
 #include "trace.hpp"
 #include "transitive_closure.hpp"
+#include "vector_clock.hpp"
+#include "witness_checker.hpp"
+#include "work_stealing_queue.hpp"
+#include "z3_configs.hpp"
+#include "z3_term_cache.hpp"
+
+enum class RFEncoding {
+    Pairwise,  // one constraint per (good write, bad write) pair of a read
+    Selector   // one selector per (read, candidate write) and a source var
+};
+
+enum class SolveMode {
+    Global,  // every COP against one formula over the whole trace
+    Sliced,  // a fresh formula per COP over the events in its cone
+    Lazy     // MHB upfront, lock and phi constraints once a model violates them
+};
+
+enum class COPOrder {
+    Trace,  // as the trace lists them, variable by variable
+    Cost    // cheap and likely races first, spread over variables
+};
+
+enum class SolverKind {
+    Z3,         // the Z3 solver over the QF_IDL formula
+    DiffLogic,  // the built-in CDCL solver over the order graph
+    SmtLib      // an external solver binary fed SMT-LIB2 files
+};
+
+struct ModelOptions {
+    bool log_witness = false;
+    bool sweep_lock_constraints = false;
+    RFEncoding rf_encoding = RFEncoding::Pairwise;
+    unsigned phi_threads = 1;  // > 1 collects phi clauses of all reads upfront
+    SolveMode solve_mode = SolveMode::Global;
+    unsigned solver_threads = 1;  // > 1 checks COPs on a pool of Z3 contexts
+    unsigned worker_processes = 0;  // > 0 checks COPs in forked processes
+    unsigned shard_size = 64;       // COPs handed to a process at a time
+    unsigned batch_size = 0;  // > 1 checks blocks of COPs in one query
+    bool shb_tier = false;    // proves races with SHB clocks before Z3
+    bool greedy_schedules = false;  // schedules COPs greedily before Z3
+    bool saturation = false;  // refutes COPs by closing the must order
+    SolverKind solver = SolverKind::Z3;
+    std::string smt_solver =  // command run on each file
+        "z3 -smt2 auto_config=false smt.arith.solver=1";
+    unsigned smt_batch = 256;  // COPs per SMT-LIB2 file
+    std::string smt_dir;       // where the files go, empty for temp
+    std::string z3_config = "idl";  // see getZ3Configs
+    unsigned portfolio_size = 0;  // > 1 races that many Z3 configurations
+    unsigned cop_timeout = 0;  // > 0 defers COPs whose check takes longer, ms
+    unsigned cop_retries = 2;  // rounds over the deferred COPs
+    unsigned time_budget = 0;  // > 0 stops solving this long after start, ms
+    COPOrder cop_order = COPOrder::Trace;
+    unsigned sample_size = 0;  // > 0 checks a stratified sample of the COPs
+    unsigned sample_seed = 1;
+    unsigned sample_regions = 4;  // trace regions the strata are split by
+    bool encode_on_demand = false;  // phi defs built and asserted per block
+    unsigned term_budget = 0;  // > 0 restarts the solver from the base once
+                               // that many phi and rf terms were asserted
+    bool unsat_cores = false;  // order facts learned from two-sided queries
+    unsigned confirm_window = 1024;  // next COPs a race model may confirm
+};
 
 class CasualModel {
    private:
     Trace& trace_;
     ModelLogger& logger_;
 
-    bool log_witness_;
+    ModelOptions options_;
+    std::chrono::steady_clock::time_point start_time_;
 
     z3::context c_;
     z3::solver s_;
 
-    z3::expr_vector var_map_;
+    Z3TermCache terms_;
     z3::expr_vector mhb_constraints_;
     z3::expr_vector lock_constraints_;
     z3::expr_vector read_to_phi_conc_;
+    z3::expr_vector rf_sources_;
+    z3::expr_vector rf_constraints_;
 
     std::unordered_map<EID, uint32_t> read_to_phi_conc_offset_;
+    std::unordered_map<EID, uint32_t> rf_source_offset_;
 
     LocksetEngine lockset_engine_;
     TransitiveClosure mhb_closure_;
+    MHBClocks mhb_clocks_;
+    CandidateWriteEngine candidate_engine_;
 
     std::vector<std::pair<Event, Event>> filtered_cop_events_;
+    std::vector<std::pair<Event, Event>> races_;
+    std::optional<std::chrono::steady_clock::time_point> first_race_time_;
+    std::mutex first_race_mutex_;
+
+    /* called by the solver threads as soon as they find a race, before the
+     * races are merged in COP order */
+    inline void noteFirstRace() {
+        std::lock_guard<std::mutex> guard(first_race_mutex_);
+        if (!first_race_time_) first_race_time_ = std::chrono::steady_clock::now();
+    }
+
+    inline void recordRace(const Event& e1, const Event& e2) {
+        noteFirstRace();
+        races_.push_back({e1, e2});
+    }
 
     void filterCOPs();
+    void prioritizeCOPs();
+    uint32_t solveTiers(uint32_t maxCOPCheck, uint32_t maxRaceCheck);
+    uint32_t solveSample();
 
-    void generateZ3VarMap();
     void generateMHBConstraints();
     void generateLockConstraints();
+    void generateSweepLockConstraints();
+
+    std::unordered_map<EID, PhiDef> read_to_phi_def_;
+    PhiFoldStats phi_fold_stats_;
+
+    std::unordered_map<EID, PhiDef> raw_phi_defs_;
+
+    const PhiDef& buildPhiDef(const Event& e);
+    void buildPhiDefs(const Event& root);
+    PhiDef& startPhiDef(const Event& e);
+    void finishPhiDef(PhiDef& def, PhiDef::Kind scKind);
+    void collectPhiClauses(PhiDef& def,
+                           CandidateWriteEngine::Candidates candidates) const;
+    void preparePhiClauses(unsigned threadCount);
+    PhiDef::Kind foldPhiSC(PhiDef& def);
+    bool foldClause(PhiClause& clause, const PhiDef& def);
+    PhiDef::Kind foldOrder(const Event& e1, const Event& e2);
+    PhiDef::Kind getPhiKind(const Event& e);
 
     z3::expr getPhiConc(Event e);
     z3::expr getPhiAbs(Event e);
-    z3::expr getPhiSC(Event e);
 
-    inline uint32_t getEventIdx(const Event e) { return e.getEventId() - 1; }
+    z3::expr encodePhiDef(const PhiDef& def);
+    void encodePhiDefs();
+
+    /* read whose phi variable phi is, 0 for true and false */
+    static EID phiRead(const z3::expr& phi);
+
+    /* on-demand encoding: rf constraints handed to the solver so far and
+     * the terms asserted past the base since it last started over */
+    size_t rf_asserted_ = 0;
+    uint64_t asserted_terms_ = 0;
+    uint64_t encoding_restarts_ = 0;
+
+    void encodeOnDemand(const z3::expr& phi, SolverBackend& solver);
+    bool restartEncoding(SolverBackend& solver, const z3::expr_vector& base);
+    z3::expr makeRFClause(const Event& read, const Event& source,
+                          z3::expr_vector& rfConstraints,
+                          const std::vector<Event>& badWrites);
+
+    inline const z3::expr& getEventOrderZ3Expr(const Event& e) {
+        return terms_.order(e.getEventId());
+    }
 
-    inline z3::expr getEventOrderZ3Expr(const Event e) {
-        return c_.int_const(("e_" + std::to_string(e.getEventId())).c_str());
+    inline const z3::expr& getEventPhiZ3Expr(const Event& e) {
+        return terms_.phi(e.getEventId());
     }
 
-    inline z3::expr getEventPhiZ3Expr(const Event e) {
-        return c_.bool_const(("phi_" + std::to_string(e.getEventId())).c_str());
+    inline const z3::expr& getEventPhiZ3Expr(const EID e) {
+        return terms_.phi(e);
     }
 
-    inline z3::expr getEventPhiZ3Expr(const EID e) {
-        return c_.bool_const(("phi_" + std::to_string(e)).c_str());
+    inline z3::expr getRFSourceZ3Expr(const Event& read) {
+        return rf_sources_[rf_source_offset_.at(read.getEventId())];
     }
 
     inline bool hb(const Event& e1, const Event& e2) {
-        return mhb_closure_.happensBefore(e1, e2) ||
-               (e1.getThreadId() == e2.getThreadId() &&
-                e1.getEventId() < e2.getEventId());
+        return mhb_clocks_.happensBefore(e1, e2);
     }
 
     inline z3::expr makeRFConstraint(const Event& read, const Event& goodWrite,
                                      const Event& badWrite) {
         /* if gw < bw -> r < bw for rf to be maintained */
-        if (hb(goodWrite, badWrite))
-            return var_map_[getEventIdx(read)] <
-                   var_map_[getEventIdx(badWrite)];
+        if (hb(goodWrite, badWrite)) return orderAtom(read, badWrite);
 
         /* if bw < r -> bw < gw for rf to be maintained */
-        if (hb(badWrite, read))
-            return var_map_[getEventIdx(badWrite)] <
-                   var_map_[getEventIdx(goodWrite)];
+        if (hb(badWrite, read)) return orderAtom(badWrite, goodWrite);
 
         /* if no hb relations then bw < gw || r < bw */
-        return var_map_[getEventIdx(badWrite)] <
-                   var_map_[getEventIdx(goodWrite)] ||
-               var_map_[getEventIdx(read)] < var_map_[getEventIdx(badWrite)];
-    }
-
-    inline void generalGoodWritesFilter(std::vector<Event>& goodWrites,
-                                        const Event& r) {
-        /* Filter out good writes w s.t. w < w' < r where w' is another good
-         * write or if r < w.
-         */
-        goodWrites.erase(
-            std::remove_if(goodWrites.begin(), goodWrites.end(),
-                           [&goodWrites, r, this](const Event& write) {
-                               return hb(r, write) ||
-                                      std::any_of(
-                                          goodWrites.begin(), goodWrites.end(),
-                                          [&write, r,
-                                           this](const Event& otherWrite) {
-                                              return (hb(write, otherWrite) &&
-                                                      hb(otherWrite, r));
-                                          });
-                           }),
-            goodWrites.end());
-    }
-
-    inline void generalBadWritesFilter(std::vector<Event>& badWrites,
-                                       const Event& r) {
-        /* Filter out bad writes w' s.t. e < w'
-         */
-        badWrites.erase(
-            std::remove_if(badWrites.begin(), badWrites.end(),
-                           [r, this](const Event& write) {
-                               return hb(r, write);
-                           }),
-            badWrites.end());
-    }
-
-    inline void prevWriteExistFilter(std::vector<Event>& writes,
-                                     const Event& prevWrite) {
-        /* When a previous write exists in the same thread, erase all writes
-         * that occur before it. This can occur in two ways:
-         * 1. The other write m.h.b before the previous write
-         * 2. The other write is in the same thread as the previous write (but
-         * we know previous write is the latest wrtie)
-         */
-        writes.erase(std::remove_if(writes.begin(), writes.end(),
-                                    [prevWrite, this](const Event& write) {
-                                        return hb(write, prevWrite);
-                                    }),
-                     writes.end());
+        return orderAtom(badWrite, goodWrite) || orderAtom(read, badWrite);
+    }
+
+    inline z3::expr makeLockConstraint(const LockRegion& lr1,
+                                       const LockRegion& lr2) {
+        return orderAtom(lr1.getRelEvent(), lr2.getAcqEvent()) ^
+               orderAtom(lr2.getRelEvent(), lr1.getAcqEvent());
+    }
+
+    /* cone of the COP being sliced, empty when solving globally */
+    std::vector<uint32_t> cone_;
+    std::vector<std::vector<Event>> thread_reads_;
+    std::vector<std::pair<Event, Event>> mhb_edges_;
+    std::vector<std::pair<LockRegion, LockRegion>> lock_pairs_;
+
+    inline bool inCone(const Event& e) {
+        return cone_.empty() ||
+               mhb_clocks_.getLocalIdx(e) <=
+                   cone_[mhb_clocks_.getThreadIdx(e.getThreadId())];
+    }
+
+    /* e1 < e2, where events outside the cone are placed after all others */
+    inline z3::expr orderAtom(const Event& e1, const Event& e2) {
+        if (!inCone(e1)) return c_.bool_val(false);
+        if (!inCone(e2)) return c_.bool_val(true);
+        return getEventOrderZ3Expr(e1) < getEventOrderZ3Expr(e2);
+    }
+
+    void extendCone(const Event& e);
+    std::vector<Event> computeCone(const Event& e1, const Event& e2);
+    uint32_t solveSliced(const z3::expr_vector& raceConstraints,
+                         uint32_t maxCOPCheck, uint32_t maxRaceCheck);
+    uint32_t solveParallel(const z3::expr_vector& raceConstraints,
+                           uint32_t maxCOPCheck, uint32_t maxRaceCheck);
+    void runShardWorker(const z3::expr_vector& raceConstraints, int taskFd,
+                        int resultFd);
+    uint32_t solveProcesses(const z3::expr_vector& raceConstraints,
+                            uint32_t maxCOPCheck, uint32_t maxRaceCheck);
+
+    /* learned from an unsat core: first is ordered before second whenever
+     * the phi of both reads holds (null events for no read) */
+    struct OrderFact {
+        Event first;
+        Event second;
+        Event first_read;
+        Event second_read;
+    };
+
+    /* facts by the thread pair (first, second) */
+    std::unordered_map<uint32_t, std::vector<OrderFact>> order_facts_;
+    uint64_t order_fact_count_ = 0;
+    uint64_t core_pruned_cops_ = 0;
+
+    static uint32_t threadPairKey(TID t1, TID t2) {
+        return (static_cast<uint32_t>(t1) << 8) | t2;
+    }
+
+    void learnOrderFact(const z3::expr_vector& core, const Event& e1,
+                        const Event& e2, const z3::expr& notAfter,
+                        const z3::expr& notBefore);
+    bool refutedByFacts(const Event& e1, const Event& e2);
+    z3::expr_vector makeRaceQuery(const Event& e1, const Event& e2);
+
+    /* order values and phi values of the last model read, by EID */
+    std::vector<int64_t> model_order_;
+    std::vector<uint8_t> model_order_known_;
+    std::vector<uint8_t> model_phi_true_;
+
+    void readModelValues(const z3::model& m);
+    uint64_t confirmFromModel(const z3::model& m,
+                              const std::vector<uint8_t>& ready,
+                              const std::vector<std::pair<EID, EID>>& copPhis,
+                              size_t begin, size_t end,
+                              std::vector<uint8_t>& confirmed,
+                              std::vector<std::vector<uint32_t>>& witnesses);
+    /* what solveWithCores checks the COPs on */
+    std::unique_ptr<SolverBackend> backend_;
+
+    /* time left of the budget, in ms; UINT_MAX without one */
+    unsigned remainingBudget() const;
+
+    /* the pinned configuration first, then the others in table order */
+    std::vector<Z3Config> portfolioConfigs() const;
+
+    uint32_t solveCOPs(uint32_t maxCOPCheck, uint32_t maxRaceCheck);
+    /* raceConstraints is empty with on-demand encoding, base is what the
+     * solver starts over from */
+    uint32_t solveWithCores(const z3::expr_vector& raceConstraints,
+                            uint32_t maxCOPCheck, uint32_t maxRaceCheck,
+                            const z3::expr_vector* base = nullptr);
+    uint32_t solveBatched(const z3::expr_vector& raceConstraints,
+                          uint32_t maxCOPCheck, uint32_t maxRaceCheck);
+
+    /* lock constraints and phi equations already added in lazy mode */
+    std::vector<uint8_t> lazy_lock_added_;
+    std::vector<uint8_t> lazy_phi_added_;
+
+    uint64_t refineLazy(const z3::model& m);
+    uint32_t solveLazy(const z3::expr_vector& raceConstraints,
+                       uint32_t maxCOPCheck, uint32_t maxRaceCheck);
+
+    /* the QF_IDL solver gives wrong answers after a check that was stopped
+     * midway, so checks that run under a timeout go to the plain SMT solver */
+    static z3::solver makeSolver(z3::context& c, const ModelOptions& options) {
+        if (options.cop_timeout || options.time_budget)
+            return z3::solver(c, z3::solver::simple());
+        return z3::solver(c, "QF_IDL");
     }
 
    public:
-    CasualModel(Trace& trace, ModelLogger& logger, bool log_witness)
+    CasualModel(Trace& trace, ModelLogger& logger, const ModelOptions& options)
         : trace_(trace),
           logger_(logger),
-          log_witness_(log_witness),
+          options_(options),
+          start_time_(std::chrono::steady_clock::now()),
           c_(),
-          s_(c_, "QF_IDL"),
-          var_map_(c_),
+          s_(makeSolver(c_, options_)),
+          terms_(c_, trace.getAllEvents().size()),
           mhb_constraints_(c_),
           lock_constraints_(c_),
           read_to_phi_conc_(c_),
-          lockset_engine_(trace_.getThreadIdToLockIdToLockRegions()) {
-        z3::params p(c_);
-        p.set("auto_config", false);
-        p.set("smt.arith.solver", (unsigned)1);
-        s_.set(p);
-        generateZ3VarMap();
+          rf_sources_(c_),
+          rf_constraints_(c_),
+          lockset_engine_(trace_.getThreadIdToLockIdToLockRegions()),
+          mhb_clocks_(trace_),
+          candidate_engine_(trace_, mhb_clocks_) {
+        applyZ3Config(s_, findZ3Config(options_.z3_config));
         generateMHBConstraints();
-        generateLockConstraints();
-        filterCOPs();
+
+        /* the COP filter only reads the MHB closure and the locksets, so it
+         * runs beside the lock constraints and the solver taking them in */
+        std::future<void> filtered =
+            std::async(std::launch::async, [this]() { filterCOPs(); });
+        if (options_.sweep_lock_constraints)
+            generateSweepLockConstraints();
+        else
+            generateLockConstraints();
+        if (options_.solve_mode == SolveMode::Global) {
+            s_.add(mhb_constraints_);
+            s_.add(lock_constraints_);
+        } else if (options_.solve_mode == SolveMode::Lazy) {
+            s_.add(mhb_constraints_);
+        }
+        filtered.get();
+        if (options_.phi_threads > 1) preparePhiClauses(options_.phi_threads);
     }
 
     uint32_t solve(uint32_t maxCOPCheck, uint32_t maxRaceCheck);
+
+    /* COPs found to be races by the last solve, in check order */
+    const std::vector<std::pair<Event, Event>>& getRaces() const {
+        return races_;
+    }
+
+    /* when the first race was found, unset if there was none */
+    const std::optional<std::chrono::steady_clock::time_point>&
+    getFirstRaceTime() const {
+        return first_race_time_;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <z3++.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+/**
+ * CheckWatchdog interrupts a Z3 context once a check runs past its
+ * deadline. One thread serves every check: Z3's own timeout parameter
+ * starts a timer per check, which on short slices costs more than the
+ * checks themselves.
+ */
+class CheckWatchdog {
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    z3::context& c_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::optional<Clock::time_point> deadline_;
+    bool fired_ = false;
+    bool shutdown_ = false;
+    std::thread thread_;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!shutdown_) {
+            if (!deadline_) {
+                cv_.wait(lock);
+            } else if (Clock::now() >= *deadline_) {
+                c_.interrupt();
+                fired_ = true;
+                deadline_.reset();
+            } else {
+                cv_.wait_until(lock, *deadline_);
+            }
+        }
+    }
+
+   public:
+    explicit CheckWatchdog(z3::context& c)
+        : c_(c), thread_(&CheckWatchdog::run, this) {}
+
+    ~CheckWatchdog() {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            shutdown_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    /* the next check may take ms, starting now */
+    void arm(unsigned ms) {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            deadline_ = Clock::now() + std::chrono::milliseconds(ms);
+            fired_ = false;
+        }
+        cv_.notify_one();
+    }
+
+    /* true if the check was interrupted */
+    bool disarm() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        deadline_.reset();
+        return fired_;
+    }
+};
@@ -12,34 +12,61 @@ struct Arguments {
     bool binaryFormat = true;    // --human optional, default true
     uint32_t maxNoOfCOP = 0;     // -c optional
     uint32_t maxNoOfRace = 0;    // -r optional
+    bool sweepLockConstraints = false; // --sweep-lock-constraints optional, default false
+    std::string rfEncoding = "pairwise"; // --rf-encoding optional, pairwise | selector
+    uint32_t phiThreads = 1;     // --phi-threads optional, default 1
+    std::string solveMode = "global"; // --solve-mode optional, global | sliced | lazy
+    uint32_t windowSize = 0;     // --window-size optional, 0 = whole trace
+    uint32_t windowOverlap = 0;  // --window-overlap optional, default 0
+    uint32_t windowThreads = 1;  // --window-threads optional, default 1
+    uint32_t solverThreads = 1;  // --solver-threads optional, default 1
+    uint32_t workerProcesses = 0; // --worker-processes optional, default 0
+    uint32_t shardSize = 64;     // --shard-size optional, default 64
+    uint32_t batchSize = 0;      // --batch-size optional, 0 = one COP per check
+    bool shbTier = false;        // --shb-tier optional, default false
+    bool greedySchedules = false; // --greedy-schedules optional, default false
+    bool saturation = false;     // --saturation optional, default false
+    std::string solver = "z3";   // --solver optional, z3 | dl | smtlib
+    std::string smtSolver =      // --smt-solver optional, solver command
+        "z3 -smt2 auto_config=false smt.arith.solver=1";
+    uint32_t smtBatch = 256;     // --smt-batch optional, COPs per SMT-LIB2 file
+    std::string smtDir;          // --smt-dir optional, default temp directory
+    std::string z3Config = "idl"; // --z3-config optional, see z3_configs.hpp
+    uint32_t portfolio = 0;      // --portfolio optional, 0 = one configuration
+    uint32_t copTimeout = 0;     // --cop-timeout optional, ms, 0 = none
+    uint32_t copRetries = 2;     // --cop-retries optional, default 2
+    uint32_t timeBudget = 0;     // --time-budget optional, ms, 0 = none
+    std::string copOrder = "trace"; // --cop-order optional, trace | cost
+    uint32_t sample = 0;         // --sample optional, COPs to check, 0 = all
+    uint32_t sampleSeed = 1;     // --sample-seed optional, default 1
+    uint32_t sampleRegions = 4;  // --sample-regions optional, default 4
+    bool encodeOnDemand = false; // --encode-on-demand optional, default false
+    uint32_t termBudget = 0;     // --term-budget optional, 0 = unbounded
+    bool unsatCores = false;     // --unsat-cores optional, default false
+    uint32_t confirmWindow = 1024; // --confirm-window optional, 0 = no confirming
+    uint32_t witnessQueue = 256; // --witness-queue optional, 0 = no writer thread
 
     static Arguments fromArgs(int argc, char* argv[]) {
-        std::string executionTrace;
-        std::string witnessDir = "witness/";
-        bool logWitness = false;
-        bool logBinaryWitness = false;
-        bool binaryFormat = true;
-        uint32_t maxNoOfCOP = 0;
-        uint32_t maxNoOfRace = 0;
+        Arguments args;
 
         std::vector<std::string> arguments(argv + 1, argv + argc);
 
         auto itr = std::find(arguments.begin(), arguments.end(), "-f");
         if (itr != arguments.end() && itr + 1 != arguments.end()) {
-            executionTrace = *(++itr);
+            args.executionTrace = *(++itr);
         } else {
             throw std::runtime_error("Please provide an input file");
         }
 
         itr = std::find(arguments.begin(), arguments.end(), "--witness-dir");
         if (itr != arguments.end() && itr + 1 != arguments.end()) {
-            witnessDir = *(++itr);
+            args.witnessDir = *(++itr);
         }
 
         itr = std::find(arguments.begin(), arguments.end(), "-c");
         if (itr != arguments.end() && itr + 1 != arguments.end()) {
             try {
-                maxNoOfCOP = static_cast<uint32_t>(std::stoul(*(++itr)));
+                args.maxNoOfCOP = static_cast<uint32_t>(std::stoul(*(++itr)));
             } catch (std::exception& e) {
                 throw std::runtime_error("Invalid max number of COP events");
             }
@@ -48,21 +75,144 @@ struct Arguments {
         itr = std::find(arguments.begin(), arguments.end(), "-r");
         if (itr != arguments.end() && itr + 1 != arguments.end()) {
             try {
-                maxNoOfRace = static_cast<uint32_t>(std::stoul(*(++itr)));
+                args.maxNoOfRace = static_cast<uint32_t>(std::stoul(*(++itr)));
             } catch (std::exception& e) {
                 throw std::runtime_error("Invalid max number of Races");
             }
         }
 
-        logWitness = std::find(arguments.begin(), arguments.end(),
-                               "--log-witness") != arguments.end();
+        itr = std::find(arguments.begin(), arguments.end(), "--rf-encoding");
+        if (itr != arguments.end() && itr + 1 != arguments.end()) {
+            args.rfEncoding = *(++itr);
+            if (args.rfEncoding != "pairwise" && args.rfEncoding != "selector")
+                throw std::runtime_error("Invalid rf encoding: " +
+                                         args.rfEncoding);
+        }
+
+        itr = std::find(arguments.begin(), arguments.end(), "--solve-mode");
+        if (itr != arguments.end() && itr + 1 != arguments.end()) {
+            args.solveMode = *(++itr);
+            if (args.solveMode != "global" && args.solveMode != "sliced" &&
+                args.solveMode != "lazy")
+                throw std::runtime_error("Invalid solve mode: " +
+                                         args.solveMode);
+        }
+
+        itr = std::find(arguments.begin(), arguments.end(), "--cop-order");
+        if (itr != arguments.end() && itr + 1 != arguments.end()) {
+            args.copOrder = *(++itr);
+            if (args.copOrder != "trace" && args.copOrder != "cost")
+                throw std::runtime_error("Invalid COP order: " + args.copOrder);
+        }
+
+        itr = std::find(arguments.begin(), arguments.end(), "--solver");
+        if (itr != arguments.end() && itr + 1 != arguments.end()) {
+            args.solver = *(++itr);
+            if (args.solver != "z3" && args.solver != "dl" &&
+                args.solver != "smtlib")
+                throw std::runtime_error("Invalid solver: " + args.solver);
+        }
+
+        itr = std::find(arguments.begin(), arguments.end(), "--smt-solver");
+        if (itr != arguments.end() && itr + 1 != arguments.end()) {
+            args.smtSolver = *(++itr);
+        }
+
+        itr = std::find(arguments.begin(), arguments.end(), "--smt-dir");
+        if (itr != arguments.end() && itr + 1 != arguments.end()) {
+            args.smtDir = *(++itr);
+        }
+
+        itr = std::find(arguments.begin(), arguments.end(), "--z3-config");
+        if (itr != arguments.end() && itr + 1 != arguments.end()) {
+            args.z3Config = *(++itr);
+        }
+
+        auto parseCount = [&arguments](const std::string& flag,
+                                       uint32_t& value,
+                                       const std::string& error) {
+            auto flagItr = std::find(arguments.begin(), arguments.end(), flag);
+            if (flagItr != arguments.end() && flagItr + 1 != arguments.end()) {
+                try {
+                    value = static_cast<uint32_t>(std::stoul(*(++flagItr)));
+                } catch (std::exception& e) {
+                    throw std::runtime_error(error);
+                }
+            }
+        };
+
+        parseCount("--window-size", args.windowSize, "Invalid window size");
+        parseCount("--window-overlap", args.windowOverlap,
+                   "Invalid window overlap");
+        parseCount("--window-threads", args.windowThreads,
+                   "Invalid number of window threads");
+        parseCount("--solver-threads", args.solverThreads,
+                   "Invalid number of solver threads");
+        parseCount("--worker-processes", args.workerProcesses,
+                   "Invalid number of worker processes");
+        parseCount("--shard-size", args.shardSize, "Invalid shard size");
+        parseCount("--batch-size", args.batchSize, "Invalid batch size");
+        parseCount("--smt-batch", args.smtBatch, "Invalid SMT-LIB batch size");
+        parseCount("--portfolio", args.portfolio,
+                   "Invalid number of portfolio configurations");
+        parseCount("--cop-timeout", args.copTimeout, "Invalid COP timeout");
+        parseCount("--cop-retries", args.copRetries,
+                   "Invalid number of COP retries");
+        parseCount("--time-budget", args.timeBudget, "Invalid time budget");
+        parseCount("--sample", args.sample, "Invalid sample size");
+        parseCount("--sample-seed", args.sampleSeed, "Invalid sample seed");
+        parseCount("--sample-regions", args.sampleRegions,
+                   "Invalid number of sample regions");
+        parseCount("--term-budget", args.termBudget, "Invalid term budget");
+        parseCount("--confirm-window", args.confirmWindow,
+                   "Invalid confirm window");
+        parseCount("--witness-queue", args.witnessQueue,
+                   "Invalid witness queue size");
+        if (args.windowSize && args.windowOverlap >= args.windowSize)
+            throw std::runtime_error("Window overlap must be below the window size");
+
+        itr = std::find(arguments.begin(), arguments.end(), "--phi-threads");
+        if (itr != arguments.end() && itr + 1 != arguments.end()) {
+            try {
+                args.phiThreads = static_cast<uint32_t>(std::stoul(*(++itr)));
+            } catch (std::exception& e) {
+                throw std::runtime_error("Invalid number of phi threads");
+            }
+            if (args.phiThreads == 0)
+                throw std::runtime_error("Invalid number of phi threads");
+        }
+
+        args.logWitness = std::find(arguments.begin(), arguments.end(),
+                                    "--log-witness") != arguments.end();
+
+        args.logBinaryWitness =
+            std::find(arguments.begin(), arguments.end(),
+                      "--log-binary-witness") != arguments.end();
+
+        args.binaryFormat = std::find(arguments.begin(), arguments.end(),
+                                      "--human") == arguments.end();
+
+        args.sweepLockConstraints =
+            std::find(arguments.begin(), arguments.end(),
+                      "--sweep-lock-constraints") != arguments.end();
+
+        args.shbTier = std::find(arguments.begin(), arguments.end(),
+                                 "--shb-tier") != arguments.end();
+
+        args.greedySchedules =
+            std::find(arguments.begin(), arguments.end(),
+                      "--greedy-schedules") != arguments.end();
+
+        args.saturation = std::find(arguments.begin(), arguments.end(),
+                                    "--saturation") != arguments.end();
 
-        logBinaryWitness = std::find(arguments.begin(), arguments.end(),
-                                     "--log-binary-witness") != arguments.end();
+        args.unsatCores = std::find(arguments.begin(), arguments.end(),
+                                    "--unsat-cores") != arguments.end();
 
-        binaryFormat = std::find(arguments.begin(), arguments.end(),
-                                 "--human") == arguments.end();
+        args.encodeOnDemand =
+            std::find(arguments.begin(), arguments.end(),
+                      "--encode-on-demand") != arguments.end();
 
-        return {executionTrace, witnessDir, logWitness, logBinaryWitness, binaryFormat, maxNoOfCOP, maxNoOfRace};
+        return args;
     }
 };
\ No newline at end of file
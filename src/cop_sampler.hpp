@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "event.hpp"
+
+/**
+ * COPSampler draws a sample of the COPs for a triage run and estimates from
+ * the races found in it how many of all COPs are races. The COPs are split
+ * into strata by variable, thread pair and the region of the trace the
+ * earlier event falls in. The budget is spread over the strata in
+ * proportion to their size, with every stratum getting at least one COP
+ * while the budget allows. The COPs of a stratum are drawn at random from a
+ * generator seeded with a fixed seed, so a run can be repeated.
+ *
+ * The race rate is the stratified mean, weighted by stratum size. Its 95%
+ * confidence interval is the normal one, with the finite population
+ * correction of each stratum; a stratum sampled once adds the largest
+ * variance a rate can have. Strata the budget did not reach are left out of
+ * the estimate and only counted.
+ */
+class COPSampler {
+   public:
+    struct Estimate {
+        uint64_t cops = 0;     // in the strata that were sampled
+        uint64_t left_out = 0;  // in strata the budget did not reach
+        uint64_t sampled = 0;
+        uint64_t races = 0;    // found in the sample
+        double rate = 0;       // estimated share of races among the COPs
+        double low = 0;        // bounds of the 95% confidence interval
+        double high = 0;
+    };
+
+   private:
+    using Key = std::tuple<uint32_t, TID, TID, uint32_t>;
+
+    struct Stratum {
+        Key key;
+        std::vector<size_t> cops;  // indices into the population
+        size_t take = 0;           // how many of them are in the sample
+    };
+
+    uint32_t seed_;
+    uint32_t regions_;
+    size_t event_count_;
+
+    std::vector<Stratum> strata_;
+    std::vector<size_t> stratum_of_;  // by sample position
+
+    static constexpr double kZ95 = 1.96;
+
+    Key keyOf(const Event& e1, const Event& e2) const {
+        TID t1 = e1.getThreadId(), t2 = e2.getThreadId();
+        EID first = std::min(e1.getEventId(), e2.getEventId());
+        uint32_t region = static_cast<uint32_t>(
+            (static_cast<uint64_t>(first - 1) * regions_) / event_count_);
+        return {e1.getTargetId(), std::min(t1, t2), std::max(t1, t2), region};
+    }
+
+    /* budget spread in proportion to the stratum sizes, by largest
+     * remainder after every stratum got its one COP */
+    void allocate(size_t budget, std::mt19937_64& rng) {
+        size_t total = 0;
+        for (const Stratum& stratum : strata_) total += stratum.cops.size();
+        if (budget >= total) {
+            for (Stratum& stratum : strata_) stratum.take = stratum.cops.size();
+            return;
+        }
+
+        if (budget < strata_.size()) {
+            std::vector<size_t> picked(strata_.size());
+            for (size_t h = 0; h < picked.size(); ++h) picked[h] = h;
+            std::shuffle(picked.begin(), picked.end(), rng);
+            for (size_t k = 0; k < budget; ++k) strata_[picked[k]].take = 1;
+            return;
+        }
+
+        size_t left = budget - strata_.size();
+        size_t rest = total - strata_.size();
+        std::vector<std::pair<double, size_t>> remainders;
+        for (size_t h = 0; h < strata_.size(); ++h) {
+            Stratum& stratum = strata_[h];
+            double share =
+                rest ? static_cast<double>(left) * (stratum.cops.size() - 1) /
+                           rest
+                     : 0;
+            stratum.take = 1 + static_cast<size_t>(share);
+            remainders.push_back({share - std::floor(share), h});
+        }
+
+        size_t given = 0;
+        for (const Stratum& stratum : strata_) given += stratum.take;
+        std::sort(remainders.begin(), remainders.end(),
+                  [](const auto& a, const auto& b) {
+                      return a.first != b.first ? a.first > b.first
+                                                : a.second < b.second;
+                  });
+        for (size_t k = 0; given < budget && k < remainders.size(); ++k) {
+            Stratum& stratum = strata_[remainders[k].second];
+            if (stratum.take < stratum.cops.size()) {
+                stratum.take++;
+                given++;
+            }
+        }
+    }
+
+    /* estimate over the strata for which keep returns true */
+    template <typename Keep>
+    Estimate estimateOver(const std::vector<uint8_t>& isRace,
+                          Keep keep) const {
+        std::vector<uint64_t> races(strata_.size(), 0);
+        for (size_t k = 0; k < stratum_of_.size(); ++k)
+            races[stratum_of_[k]] += isRace[k];
+
+        Estimate estimate;
+        double variance = 0;
+        for (size_t h = 0; h < strata_.size(); ++h) {
+            const Stratum& stratum = strata_[h];
+            if (!keep(stratum.key)) continue;
+            if (!stratum.take) {
+                estimate.left_out += stratum.cops.size();
+                continue;
+            }
+
+            estimate.cops += stratum.cops.size();
+            estimate.sampled += stratum.take;
+            estimate.races += races[h];
+
+            double size = static_cast<double>(stratum.cops.size());
+            double n = static_cast<double>(stratum.take);
+            double p = races[h] / n;
+            estimate.rate += size * p;
+
+            double spread = stratum.take > 1 ? p * (1 - p) * n / (n - 1)
+                                             : 0.25;
+            variance += size * size * (1 - n / size) * spread / n;
+        }
+        if (!estimate.cops) return estimate;
+
+        double total = static_cast<double>(estimate.cops);
+        estimate.rate /= total;
+        double margin = kZ95 * std::sqrt(variance) / total;
+        estimate.low = std::max(0.0, estimate.rate - margin);
+        estimate.high = std::min(1.0, estimate.rate + margin);
+        return estimate;
+    }
+
+   public:
+    COPSampler(size_t eventCount, uint32_t regions, uint32_t seed)
+        : seed_(seed),
+          regions_(std::max<uint32_t>(regions, 1)),
+          event_count_(std::max<size_t>(eventCount, 1)) {}
+
+    /* indices of the sampled COPs, in population order */
+    std::vector<size_t> draw(const std::vector<std::pair<Event, Event>>& cops,
+                             size_t budget) {
+        std::map<Key, size_t> index;
+        strata_.clear();
+        for (size_t i = 0; i < cops.size(); ++i) {
+            Key key = keyOf(cops[i].first, cops[i].second);
+            auto [it, inserted] = index.try_emplace(key, strata_.size());
+            if (inserted) strata_.push_back({key, {}, 0});
+            strata_[it->second].cops.push_back(i);
+        }
+
+        std::mt19937_64 rng(seed_);
+        allocate(budget, rng);
+
+        std::vector<std::pair<size_t, size_t>> sample;  // COP, stratum
+        for (size_t h = 0; h < strata_.size(); ++h) {
+            std::vector<size_t> members = strata_[h].cops;
+            for (size_t k = 0; k < strata_[h].take; ++k) {
+                std::uniform_int_distribution<size_t> pick(k,
+                                                           members.size() - 1);
+                std::swap(members[k], members[pick(rng)]);
+                sample.push_back({members[k], h});
+            }
+        }
+        std::sort(sample.begin(), sample.end());
+
+        std::vector<size_t> drawn;
+        stratum_of_.clear();
+        for (const auto& [cop, h] : sample) {
+            drawn.push_back(cop);
+            stratum_of_.push_back(h);
+        }
+        return drawn;
+    }
+
+    size_t getStrataCount() const { return strata_.size(); }
+
+    /* isRace tells for every sampled COP, in sample order, if it is a race */
+    Estimate estimate(const std::vector<uint8_t>& isRace) const {
+        return estimateOver(isRace, [](const Key&) { return true; });
+    }
+
+    /* the same, over the COPs of one variable */
+    Estimate estimate(const std::vector<uint8_t>& isRace,
+                      uint32_t variable) const {
+        return estimateOver(isRace, [variable](const Key& key) {
+            return std::get<0>(key) == variable;
+        });
+    }
+};
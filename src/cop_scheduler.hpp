@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "event.hpp"
+#include "trace.hpp"
+#include "vector_clock.hpp"
+
+/**
+ * COPScheduler orders the COPs so that the ones likely to be races, and
+ * cheap to check, come first. Every COP is scored by features that need no
+ * solver: how far apart the two events are in the trace, the size of their
+ * causal cone, the reads in that cone whose phi the query pulls in, and the
+ * lock regions the events sit in. Each feature is turned into a rank among
+ * the COPs and the ranks are summed, so no feature dominates by its scale.
+ * The COPs are then spread over their variable and thread pair: every pass
+ * takes the next best COP of each group, in score order, so that a cut off
+ * run still covers as many of them as it can.
+ */
+class COPScheduler {
+   public:
+    struct Features {
+        uint64_t distance = 0;    // events between the two in the trace
+        uint64_t cone = 0;        // events in the joined causal past
+        uint64_t phi_reads = 0;   // reads among them
+        uint64_t lock_depth = 0;  // lock regions around the two events
+    };
+
+    struct Stats {
+        uint64_t cops = 0;
+        uint64_t groups = 0;  // distinct variable and thread pairs
+        uint64_t passes = 0;
+    };
+
+   private:
+    const MHBClocks& clocks_;
+
+    /* reads among the first k events of each thread, by thread idx */
+    std::vector<std::vector<uint32_t>> read_prefix_;
+    std::vector<uint32_t> lock_depth_;  // by event idx
+
+    Stats stats_;
+
+    /* rank of every value, equal values sharing the lowest rank */
+    static std::vector<uint64_t> ranks(const std::vector<uint64_t>& values) {
+        std::vector<size_t> idx(values.size());
+        std::iota(idx.begin(), idx.end(), 0);
+        std::stable_sort(idx.begin(), idx.end(), [&](size_t a, size_t b) {
+            return values[a] < values[b];
+        });
+
+        std::vector<uint64_t> rank(values.size(), 0);
+        for (size_t k = 0; k < idx.size(); ++k) {
+            bool tie = k > 0 && values[idx[k]] == values[idx[k - 1]];
+            rank[idx[k]] = tie ? rank[idx[k - 1]] : k;
+        }
+        return rank;
+    }
+
+   public:
+    COPScheduler(const Trace& trace, const MHBClocks& clocks)
+        : clocks_(clocks),
+          read_prefix_(clocks.getThreadCount()),
+          lock_depth_(trace.getAllEvents().size(), 0) {
+        for (const Thread& thread : trace.getThreads()) {
+            std::vector<uint32_t>& prefix =
+                read_prefix_[clocks_.getThreadIdx(thread.getThreadId())];
+            prefix.push_back(0);
+
+            uint32_t depth = 0;
+            for (const Event& e : thread.getEvents()) {
+                prefix.push_back(prefix.back() +
+                                 (e.getEventType() == Event::EventType::Read));
+
+                if (e.getEventType() == Event::EventType::Release && depth)
+                    depth--;
+                lock_depth_[e.getEventId() - 1] = depth;
+                if (e.getEventType() == Event::EventType::Acquire) depth++;
+            }
+        }
+    }
+
+    Features features(const Event& e1, const Event& e2) const {
+        Features f;
+        EID id1 = e1.getEventId(), id2 = e2.getEventId();
+        f.distance = id1 < id2 ? id2 - id1 : id1 - id2;
+
+        std::vector<uint32_t> cone(clocks_.getThreadCount(), 0);
+        clocks_.joinInto(e1, cone);
+        clocks_.joinInto(e2, cone);
+        for (size_t t = 0; t < cone.size(); ++t) {
+            f.cone += cone[t];
+            f.phi_reads += read_prefix_[t][cone[t]];
+        }
+
+        f.lock_depth = lock_depth_[id1 - 1] + lock_depth_[id2 - 1];
+        return f;
+    }
+
+    /* the COPs in the order to check them, as indices into cops */
+    std::vector<size_t> order(const std::vector<std::pair<Event, Event>>& cops) {
+        size_t n = cops.size();
+        std::vector<uint64_t> distance(n), cone(n), reads(n), depth(n);
+        for (size_t i = 0; i < n; ++i) {
+            Features f = features(cops[i].first, cops[i].second);
+            distance[i] = f.distance;
+            cone[i] = f.cone;
+            reads[i] = f.phi_reads;
+            depth[i] = f.lock_depth;
+        }
+
+        std::vector<uint64_t> score = ranks(distance);
+        for (const auto* values : {&cone, &reads, &depth}) {
+            std::vector<uint64_t> rank = ranks(*values);
+            for (size_t i = 0; i < n; ++i) score[i] += rank[i];
+        }
+
+        /* the COPs of each variable and thread pair, best first */
+        std::map<std::tuple<uint32_t, TID, TID>, std::vector<size_t>> groups;
+        for (size_t i = 0; i < n; ++i) {
+            const auto& [e1, e2] = cops[i];
+            TID t1 = e1.getThreadId(), t2 = e2.getThreadId();
+            groups[{e1.getTargetId(), std::min(t1, t2), std::max(t1, t2)}]
+                .push_back(i);
+        }
+        auto better = [&](size_t a, size_t b) {
+            return score[a] != score[b] ? score[a] < score[b] : a < b;
+        };
+        size_t passes = 0;
+        for (auto& [_, members] : groups) {
+            std::sort(members.begin(), members.end(), better);
+            passes = std::max(passes, members.size());
+        }
+
+        std::vector<size_t> result, pass;
+        result.reserve(n);
+        for (size_t k = 0; k < passes; ++k) {
+            pass.clear();
+            for (const auto& [_, members] : groups)
+                if (k < members.size()) pass.push_back(members[k]);
+            std::sort(pass.begin(), pass.end(), better);
+            result.insert(result.end(), pass.begin(), pass.end());
+        }
+
+        stats_.cops += n;
+        stats_.groups += groups.size();
+        stats_.passes += passes;
+        return result;
+    }
+
+    const Stats& getStats() const { return stats_; }
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <z3++.h>
+
+#include <vector>
+
+#include "BSlogger.hpp"
+#include "diff_logic_solver.hpp"
+#include "diff_logic_translator.hpp"
+#include "solver_backend.hpp"
+
+/**
+ * DiffLogicBackend checks on the built-in DiffLogicSolver, translating the
+ * Z3 terms of the encoding as they are added.
+ */
+class DiffLogicBackend : public SolverBackend {
+   private:
+    DiffLogicSolver solver_;
+    DiffLogicTranslator translator_;
+
+   public:
+    explicit DiffLogicBackend(z3::context& c) : translator_(solver_, c) {}
+
+    void add(const z3::expr& e) override { translator_.assertFormula(e); }
+
+    Answer check(const z3::expr_vector& assumptions) override {
+        std::vector<DiffLogicSolver::Lit> lits;
+        for (const z3::expr& e : assumptions)
+            lits.push_back(translator_.translate(e));
+
+        Answer answer;
+        if (solver_.check(lits) == DiffLogicSolver::Result::Sat) {
+            answer.result = Result::Sat;
+            answer.model = translator_.getModel();
+            return answer;
+        }
+
+        answer.result = Result::Unsat;
+        for (DiffLogicSolver::Lit lit : solver_.getCore()) {
+            for (size_t i = 0; i < lits.size(); ++i)
+                if (lits[i] == lit) answer.core.push_back(i);
+        }
+        return answer;
+    }
+
+    void logStats() const override {
+        LOG_INIT_COUT();
+        const DiffLogicSolver::Stats& stats = solver_.getStats();
+        log(LOG_INFO) << "Difference logic solver: " << stats.checks
+                      << " checks, " << solver_.getVarCount() << " vars, "
+                      << solver_.getNodeCount() << " nodes, "
+                      << stats.decisions << " decisions, " << stats.conflicts
+                      << " conflicts (" << stats.theory_conflicts
+                      << " negative cycles), " << stats.learnt_clauses
+                      << " learnt clauses, " << stats.restarts
+                      << " restarts\n";
+    }
+};
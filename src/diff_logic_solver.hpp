@@ -0,0 +1,568 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * DiffLogicSolver decides clauses over Boolean variables and difference
+ * atoms x - y <= k between integer nodes, the fragment the race encoding
+ * lives in. A CDCL core (two watched literals, VSIDS, first UIP learning,
+ * Luby restarts) assigns the literals, and every assigned atom adds an edge
+ * to an order graph: x - y <= k is the edge y -> x of weight k, its negation
+ * the edge x -> y of weight -k - 1. The graph keeps a feasible value for
+ * every node and repairs it when an edge is added by relaxing forward from
+ * the head of the edge. A repair that would lower the tail of the new edge
+ * closes a negative cycle, whose literals form the conflict clause. Edges
+ * are removed on backtracking; the values stay feasible for fewer edges.
+ * Assumptions are decided first, and an unsat answer reports the ones the
+ * refutation needed.
+ */
+class DiffLogicSolver {
+   public:
+    using Lit = uint32_t;  // 2 * var + 1 if negated
+
+    enum class Result { Sat, Unsat };
+
+    struct Stats {
+        uint64_t checks = 0;
+        uint64_t decisions = 0;
+        uint64_t propagations = 0;
+        uint64_t conflicts = 0;
+        uint64_t theory_conflicts = 0;
+        uint64_t restarts = 0;
+        uint64_t learnt_clauses = 0;
+    };
+
+    static constexpr Lit kUndefLit = UINT32_MAX;
+
+    static Lit mkLit(uint32_t var, bool negated = false) {
+        return (var << 1) | (negated ? 1 : 0);
+    }
+    static Lit negate(Lit lit) { return lit ^ 1; }
+    static uint32_t varOf(Lit lit) { return lit >> 1; }
+
+   private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+    static constexpr uint8_t kFalse = 0, kTrue = 1, kUndef = 2;
+
+    struct Atom {
+        uint32_t x;
+        uint32_t y;
+        int64_t k;
+    };
+
+    struct Edge {
+        uint32_t from;
+        uint32_t to;
+        int64_t weight;
+        Lit lit;
+        uint32_t trail_pos;
+    };
+
+    bool ok_ = true;
+    Lit true_lit_;
+
+    /* per variable */
+    std::vector<uint8_t> assigns_;
+    std::vector<uint32_t> level_;
+    std::vector<uint32_t> reason_;  // clause idx, kNone for decisions
+    std::vector<uint8_t> polarity_;  // saved phase, 1 for negated
+    std::vector<uint8_t> seen_;
+    std::vector<uint32_t> atom_of_;
+    std::vector<double> activity_;
+    double var_inc_ = 1.0;
+
+    /* activity max heap over the variables */
+    std::vector<uint32_t> heap_;
+    std::vector<uint32_t> heap_pos_;
+
+    std::vector<std::vector<Lit>> clauses_;
+    std::vector<std::vector<uint32_t>> watches_;  // by literal
+
+    std::vector<Lit> trail_;
+    std::vector<uint32_t> trail_lim_;
+    size_t qhead_ = 0;
+
+    std::vector<Atom> atoms_;
+    std::unordered_map<uint64_t, std::vector<std::pair<int64_t, uint32_t>>>
+        atom_cache_;  // by (x, y), the k and variable of each atom
+
+    /* order graph */
+    std::vector<int64_t> values_;
+    std::vector<std::vector<uint32_t>> out_;  // edge idxs by tail
+    std::vector<Edge> edges_;
+    std::vector<uint32_t> pred_;  // edge that last lowered a node
+    std::vector<uint8_t> in_queue_;
+    std::vector<uint32_t> queue_;
+    std::vector<std::pair<uint32_t, int64_t>> undo_;
+
+    std::vector<Lit> conflict_;
+    std::vector<Lit> core_;
+    std::vector<uint8_t> model_assigns_;
+    std::vector<int64_t> model_values_;
+
+    Stats stats_;
+
+    uint8_t value(Lit lit) const {
+        uint8_t a = assigns_[varOf(lit)];
+        return a == kUndef ? kUndef : static_cast<uint8_t>(a ^ (lit & 1));
+    }
+
+    uint32_t decisionLevel() const {
+        return static_cast<uint32_t>(trail_lim_.size());
+    }
+
+    void enqueue(Lit lit, uint32_t reason) {
+        uint32_t v = varOf(lit);
+        assigns_[v] = (lit & 1) ? kFalse : kTrue;
+        level_[v] = decisionLevel();
+        reason_[v] = reason;
+        trail_.push_back(lit);
+    }
+
+    bool heapLess(uint32_t a, uint32_t b) const {
+        return activity_[a] > activity_[b];
+    }
+
+    void heapUp(size_t i) {
+        uint32_t v = heap_[i];
+        while (i > 0 && heapLess(v, heap_[(i - 1) / 2])) {
+            heap_[i] = heap_[(i - 1) / 2];
+            heap_pos_[heap_[i]] = static_cast<uint32_t>(i);
+            i = (i - 1) / 2;
+        }
+        heap_[i] = v;
+        heap_pos_[v] = static_cast<uint32_t>(i);
+    }
+
+    void heapDown(size_t i) {
+        uint32_t v = heap_[i];
+        while (2 * i + 1 < heap_.size()) {
+            size_t child = 2 * i + 1;
+            if (child + 1 < heap_.size() &&
+                heapLess(heap_[child + 1], heap_[child]))
+                child++;
+            if (!heapLess(heap_[child], v)) break;
+            heap_[i] = heap_[child];
+            heap_pos_[heap_[i]] = static_cast<uint32_t>(i);
+            i = child;
+        }
+        heap_[i] = v;
+        heap_pos_[v] = static_cast<uint32_t>(i);
+    }
+
+    void heapInsert(uint32_t v) {
+        if (heap_pos_[v] != kNone) return;
+        heap_.push_back(v);
+        heapUp(heap_.size() - 1);
+    }
+
+    uint32_t heapPop() {
+        uint32_t v = heap_[0];
+        heap_pos_[v] = kNone;
+        heap_[0] = heap_.back();
+        heap_.pop_back();
+        if (!heap_.empty()) heapDown(0);
+        return v;
+    }
+
+    void bumpActivity(uint32_t v) {
+        if ((activity_[v] += var_inc_) > 1e100) {
+            for (double& a : activity_) a *= 1e-100;
+            var_inc_ *= 1e-100;
+        }
+        if (heap_pos_[v] != kNone) heapUp(heap_pos_[v]);
+    }
+
+    void cancelUntil(uint32_t level) {
+        if (decisionLevel() <= level) return;
+
+        uint32_t lim = trail_lim_[level];
+        while (!edges_.empty() && edges_.back().trail_pos >= lim) {
+            out_[edges_.back().from].pop_back();
+            edges_.pop_back();
+        }
+
+        for (size_t i = trail_.size(); i-- > lim;) {
+            uint32_t v = varOf(trail_[i]);
+            polarity_[v] = trail_[i] & 1;
+            assigns_[v] = kUndef;
+            heapInsert(v);
+        }
+        trail_.resize(lim);
+        trail_lim_.resize(level);
+        qhead_ = lim;
+    }
+
+    /* adds the edge of an assigned atom, false on a negative cycle */
+    bool assertAtom(Lit lit, uint32_t trailPos) {
+        const Atom& atom = atoms_[atom_of_[varOf(lit)]];
+        Edge edge = (lit & 1)
+                        ? Edge{atom.x, atom.y, -atom.k - 1, lit, trailPos}
+                        : Edge{atom.y, atom.x, atom.k, lit, trailPos};
+
+        uint32_t idx = static_cast<uint32_t>(edges_.size());
+        edges_.push_back(edge);
+        out_[edge.from].push_back(idx);
+
+        if (values_[edge.to] <= values_[edge.from] + edge.weight) return true;
+
+        undo_.clear();
+        queue_.clear();
+        undo_.emplace_back(edge.to, values_[edge.to]);
+        values_[edge.to] = values_[edge.from] + edge.weight;
+        pred_[edge.to] = idx;
+        queue_.push_back(edge.to);
+        in_queue_[edge.to] = 1;
+
+        bool cycle = false;
+        for (size_t head = 0; head < queue_.size() && !cycle; ++head) {
+            uint32_t u = queue_[head];
+            in_queue_[u] = 0;
+            for (uint32_t e : out_[u]) {
+                const Edge& next = edges_[e];
+                int64_t lowered = values_[u] + next.weight;
+                if (lowered >= values_[next.to]) continue;
+
+                if (next.to == edge.from) {
+                    explainCycle(e, edge.to);
+                    cycle = true;
+                    break;
+                }
+
+                undo_.emplace_back(next.to, values_[next.to]);
+                values_[next.to] = lowered;
+                pred_[next.to] = e;
+                if (!in_queue_[next.to]) {
+                    in_queue_[next.to] = 1;
+                    queue_.push_back(next.to);
+                }
+            }
+        }
+
+        for (uint32_t u : queue_) in_queue_[u] = 0;
+        if (!cycle) return true;
+
+        for (size_t i = undo_.size(); i-- > 0;)
+            values_[undo_[i].first] = undo_[i].second;
+        stats_.theory_conflicts++;
+        return false;
+    }
+
+    /* the closing edge, then the lowering edges back to the new edge */
+    void explainCycle(uint32_t closing, uint32_t head) {
+        conflict_.clear();
+        conflict_.push_back(negate(edges_[closing].lit));
+        for (uint32_t u = edges_[closing].from;;) {
+            const Edge& e = edges_[pred_[u]];
+            conflict_.push_back(negate(e.lit));
+            if (u == head) break;
+            u = e.from;
+        }
+    }
+
+    /* false on a conflict, whose clause is left in conflict_ */
+    bool propagate() {
+        while (qhead_ < trail_.size()) {
+            Lit p = trail_[qhead_++];
+            stats_.propagations++;
+            if (atom_of_[varOf(p)] != kNone &&
+                !assertAtom(p, static_cast<uint32_t>(qhead_ - 1))) {
+                qhead_ = trail_.size();
+                return false;
+            }
+
+            Lit falseLit = negate(p);
+            std::vector<uint32_t>& ws = watches_[falseLit];
+            size_t i = 0, j = 0;
+            while (i < ws.size()) {
+                uint32_t ci = ws[i++];
+                std::vector<Lit>& c = clauses_[ci];
+                if (c[0] == falseLit) std::swap(c[0], c[1]);
+
+                if (value(c[0]) == kTrue) {
+                    ws[j++] = ci;
+                    continue;
+                }
+
+                bool moved = false;
+                for (size_t k = 2; k < c.size(); ++k) {
+                    if (value(c[k]) == kFalse) continue;
+                    std::swap(c[1], c[k]);
+                    watches_[c[1]].push_back(ci);
+                    moved = true;
+                    break;
+                }
+                if (moved) continue;
+
+                ws[j++] = ci;
+                if (value(c[0]) == kFalse) {
+                    conflict_ = c;
+                    while (i < ws.size()) ws[j++] = ws[i++];
+                    ws.resize(j);
+                    qhead_ = trail_.size();
+                    return false;
+                }
+                enqueue(c[0], ci);
+            }
+            ws.resize(j);
+        }
+        return true;
+    }
+
+    /* first UIP clause of conflict_, asserting literal first */
+    uint32_t analyze(std::vector<Lit>& learnt) {
+        learnt.assign(1, kUndefLit);
+        uint32_t pathCount = 0;
+        Lit p = kUndefLit;
+        size_t index = trail_.size();
+        const std::vector<Lit>* clause = &conflict_;
+
+        do {
+            for (Lit q : *clause) {
+                uint32_t v = varOf(q);
+                if (q == p || seen_[v] || level_[v] == 0) continue;
+                seen_[v] = 1;
+                bumpActivity(v);
+                if (level_[v] >= decisionLevel())
+                    pathCount++;
+                else
+                    learnt.push_back(q);
+            }
+
+            while (!seen_[varOf(trail_[--index])]) {
+            }
+            p = trail_[index];
+            seen_[varOf(p)] = 0;
+            pathCount--;
+            if (pathCount > 0) clause = &clauses_[reason_[varOf(p)]];
+        } while (pathCount > 0);
+        learnt[0] = negate(p);
+
+        uint32_t backtrack = 0;
+        for (size_t i = 1; i < learnt.size(); ++i) {
+            seen_[varOf(learnt[i])] = 0;
+            if (level_[varOf(learnt[i])] > backtrack) {
+                backtrack = level_[varOf(learnt[i])];
+                std::swap(learnt[1], learnt[i]);
+            }
+        }
+        return backtrack;
+    }
+
+    /* the assumptions that force p, which falsifies the assumption ~p */
+    void analyzeFinal(Lit p) {
+        core_.assign(1, negate(p));
+        if (decisionLevel() == 0) return;
+
+        seen_[varOf(p)] = 1;
+        for (size_t i = trail_.size(); i-- > trail_lim_[0];) {
+            uint32_t v = varOf(trail_[i]);
+            if (!seen_[v]) continue;
+
+            if (reason_[v] == kNone) {
+                core_.push_back(trail_[i]);
+            } else {
+                for (Lit q : clauses_[reason_[v]])
+                    if (varOf(q) != v && level_[varOf(q)] > 0)
+                        seen_[varOf(q)] = 1;
+            }
+            seen_[v] = 0;
+        }
+        seen_[varOf(p)] = 0;
+    }
+
+    Lit pickBranchLit() {
+        while (!heap_.empty()) {
+            uint32_t v = heapPop();
+            if (assigns_[v] == kUndef) return mkLit(v, polarity_[v]);
+        }
+        return kUndefLit;
+    }
+
+    static uint64_t luby(uint64_t i) {
+        uint64_t size = 1, seq = 0;
+        while (size < i + 1) {
+            seq++;
+            size = 2 * size + 1;
+        }
+        while (size - 1 != i) {
+            size = (size - 1) >> 1;
+            seq--;
+            i = i % size;
+        }
+        return uint64_t{1} << seq;
+    }
+
+   public:
+    DiffLogicSolver() {
+        true_lit_ = mkLit(newVar());
+        addClause({true_lit_});
+    }
+
+    uint32_t newVar() {
+        uint32_t v = static_cast<uint32_t>(assigns_.size());
+        assigns_.push_back(kUndef);
+        level_.push_back(0);
+        reason_.push_back(kNone);
+        polarity_.push_back(1);
+        seen_.push_back(0);
+        atom_of_.push_back(kNone);
+        activity_.push_back(0.0);
+        heap_pos_.push_back(kNone);
+        watches_.emplace_back();
+        watches_.emplace_back();
+        heapInsert(v);
+        return v;
+    }
+
+    uint32_t newNode() {
+        uint32_t n = static_cast<uint32_t>(values_.size());
+        values_.push_back(0);
+        out_.emplace_back();
+        pred_.push_back(kNone);
+        in_queue_.push_back(0);
+        return n;
+    }
+
+    Lit trueLit() const { return true_lit_; }
+
+    /* the literal of x - y <= k */
+    Lit atom(uint32_t x, uint32_t y, int64_t k) {
+        if (x == y) return k >= 0 ? true_lit_ : negate(true_lit_);
+
+        std::vector<std::pair<int64_t, uint32_t>>& known =
+            atom_cache_[(static_cast<uint64_t>(x) << 32) | y];
+        for (const auto& [bound, var] : known)
+            if (bound == k) return mkLit(var);
+
+        uint32_t var = newVar();
+        atom_of_[var] = static_cast<uint32_t>(atoms_.size());
+        atoms_.push_back({x, y, k});
+        known.emplace_back(k, var);
+        return mkLit(var);
+    }
+
+    /* only between checks, false once the clauses are unsat */
+    bool addClause(std::vector<Lit> lits) {
+        if (!ok_) return false;
+
+        std::sort(lits.begin(), lits.end());
+        size_t j = 0;
+        for (size_t i = 0; i < lits.size(); ++i) {
+            if (value(lits[i]) == kTrue ||
+                (i > 0 && lits[i] == negate(lits[i - 1])))
+                return true;
+            if (value(lits[i]) == kFalse || (j > 0 && lits[j - 1] == lits[i]))
+                continue;
+            lits[j++] = lits[i];
+        }
+        lits.resize(j);
+
+        if (lits.empty()) return ok_ = false;
+        if (lits.size() == 1) {
+            enqueue(lits[0], kNone);
+            return ok_ = propagate();
+        }
+
+        uint32_t ci = static_cast<uint32_t>(clauses_.size());
+        watches_[lits[0]].push_back(ci);
+        watches_[lits[1]].push_back(ci);
+        clauses_.push_back(std::move(lits));
+        return true;
+    }
+
+    Result check(const std::vector<Lit>& assumptions = {}) {
+        stats_.checks++;
+        core_.clear();
+        if (!ok_) return Result::Unsat;
+
+        uint64_t conflicts = 0;
+        uint64_t restartLimit = 100 * luby(stats_.restarts);
+        std::vector<Lit> learnt;
+
+        while (true) {
+            if (!propagate()) {
+                stats_.conflicts++;
+                conflicts++;
+                if (decisionLevel() == 0) {
+                    ok_ = false;
+                    return Result::Unsat;
+                }
+
+                uint32_t backtrack = analyze(learnt);
+                cancelUntil(backtrack);
+                if (learnt.size() == 1) {
+                    enqueue(learnt[0], kNone);
+                } else {
+                    uint32_t ci = static_cast<uint32_t>(clauses_.size());
+                    watches_[learnt[0]].push_back(ci);
+                    watches_[learnt[1]].push_back(ci);
+                    clauses_.push_back(learnt);
+                    stats_.learnt_clauses++;
+                    enqueue(learnt[0], ci);
+                }
+                var_inc_ /= 0.95;
+                continue;
+            }
+
+            if (conflicts >= restartLimit) {
+                stats_.restarts++;
+                conflicts = 0;
+                restartLimit = 100 * luby(stats_.restarts);
+                cancelUntil(0);
+                continue;
+            }
+
+            Lit next = kUndefLit;
+            while (decisionLevel() < assumptions.size()) {
+                Lit p = assumptions[decisionLevel()];
+                if (value(p) == kTrue) {
+                    trail_lim_.push_back(static_cast<uint32_t>(trail_.size()));
+                } else if (value(p) == kFalse) {
+                    analyzeFinal(negate(p));
+                    cancelUntil(0);
+                    return Result::Unsat;
+                } else {
+                    next = p;
+                    break;
+                }
+            }
+
+            if (next == kUndefLit) {
+                next = pickBranchLit();
+                if (next == kUndefLit) {
+                    model_assigns_ = assigns_;
+                    model_values_ = values_;
+                    cancelUntil(0);
+                    return Result::Sat;
+                }
+                stats_.decisions++;
+            }
+
+            trail_lim_.push_back(static_cast<uint32_t>(trail_.size()));
+            enqueue(next, kNone);
+        }
+    }
+
+    /* value in the model of the last sat check */
+    bool modelValue(Lit lit) const {
+        if (varOf(lit) >= model_assigns_.size()) return false;
+        return (model_assigns_[varOf(lit)] ^ (lit & 1)) == kTrue;
+    }
+
+    int64_t modelValue(uint32_t node, uint32_t zero) const {
+        return model_values_[node] - model_values_[zero];
+    }
+
+    /* assumptions the last unsat check needed */
+    const std::vector<Lit>& getCore() const { return core_; }
+
+    size_t getVarCount() const { return assigns_.size(); }
+    size_t getNodeCount() const { return values_.size(); }
+    size_t getClauseCount() const { return clauses_.size(); }
+    const Stats& getStats() const { return stats_; }
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <z3++.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "diff_logic_solver.hpp"
+
+/**
+ * DiffLogicTranslator feeds the Z3 terms of the race encoding to a
+ * DiffLogicSolver. Integer constants become nodes of the order graph (and
+ * numerals offsets from a zero node), comparisons between them difference
+ * atoms, and the Boolean structure is turned into clauses through Tseitin
+ * variables. Translated terms are cached by their AST id and kept alive so
+ * an id is never reused for another term. After a sat check the model can
+ * be handed back as a z3::model over the translated constants.
+ */
+class DiffLogicTranslator {
+   public:
+    using Lit = DiffLogicSolver::Lit;
+
+   private:
+    DiffLogicSolver& solver_;
+    z3::context& c_;
+    z3::expr_vector keep_;
+    uint32_t zero_;
+
+    std::unordered_map<unsigned, Lit> lits_;         // by AST id
+    std::unordered_map<unsigned, uint32_t> nodes_;   // by AST id
+    std::vector<std::pair<z3::expr, uint32_t>> int_consts_;
+    std::vector<std::pair<z3::expr, Lit>> bool_consts_;
+
+    /* node and offset of an integer term */
+    std::pair<uint32_t, int64_t> term(const z3::expr& e) {
+        int64_t numeral;
+        if (e.is_numeral_i64(numeral)) return {zero_, numeral};
+
+        if (!e.is_const())
+            throw std::runtime_error("Unsupported integer term: " +
+                                     e.to_string());
+
+        auto it = nodes_.find(e.id());
+        if (it != nodes_.end()) return {it->second, 0};
+
+        uint32_t node = solver_.newNode();
+        keep_.push_back(e);
+        nodes_[e.id()] = node;
+        int_consts_.emplace_back(e, node);
+        return {node, 0};
+    }
+
+    /* a - b <= k */
+    Lit lessEq(const z3::expr& a, const z3::expr& b, int64_t k) {
+        auto [na, oa] = term(a);
+        auto [nb, ob] = term(b);
+        return solver_.atom(na, nb, k + ob - oa);
+    }
+
+    /* g <-> and(lits) */
+    Lit defineAnd(const std::vector<Lit>& lits) {
+        Lit g = DiffLogicSolver::mkLit(solver_.newVar());
+        std::vector<Lit> all{g};
+        for (Lit lit : lits) {
+            solver_.addClause({DiffLogicSolver::negate(g), lit});
+            all.push_back(DiffLogicSolver::negate(lit));
+        }
+        solver_.addClause(std::move(all));
+        return g;
+    }
+
+    Lit defineXor(Lit a, Lit b) {
+        Lit g = DiffLogicSolver::mkLit(solver_.newVar());
+        Lit na = DiffLogicSolver::negate(a), nb = DiffLogicSolver::negate(b);
+        Lit ng = DiffLogicSolver::negate(g);
+        solver_.addClause({ng, a, b});
+        solver_.addClause({ng, na, nb});
+        solver_.addClause({g, na, b});
+        solver_.addClause({g, a, nb});
+        return g;
+    }
+
+    Lit encode(const z3::expr& e) {
+        if (e.is_true()) return solver_.trueLit();
+        if (e.is_false()) return DiffLogicSolver::negate(solver_.trueLit());
+
+        if (e.is_const()) {
+            Lit lit = DiffLogicSolver::mkLit(solver_.newVar());
+            bool_consts_.emplace_back(e, lit);
+            return lit;
+        }
+
+        if (e.is_not()) return DiffLogicSolver::negate(translate(e.arg(0)));
+
+        std::vector<Lit> args;
+        switch (e.decl().decl_kind()) {
+            case Z3_OP_AND:
+            case Z3_OP_OR: {
+                bool isOr = e.is_or();
+                for (unsigned i = 0; i < e.num_args(); ++i) {
+                    Lit lit = translate(e.arg(i));
+                    args.push_back(isOr ? DiffLogicSolver::negate(lit) : lit);
+                }
+                /* or(a, b) is not(and(not a, not b)) */
+                Lit g = defineAnd(args);
+                return isOr ? DiffLogicSolver::negate(g) : g;
+            }
+            case Z3_OP_IMPLIES:
+                return DiffLogicSolver::negate(
+                    defineAnd({translate(e.arg(0)),
+                               DiffLogicSolver::negate(translate(e.arg(1)))}));
+            case Z3_OP_XOR:
+                return defineXor(translate(e.arg(0)), translate(e.arg(1)));
+            case Z3_OP_EQ:
+                if (e.arg(0).is_bool())
+                    return DiffLogicSolver::negate(
+                        defineXor(translate(e.arg(0)), translate(e.arg(1))));
+                return defineAnd({lessEq(e.arg(0), e.arg(1), 0),
+                                  lessEq(e.arg(1), e.arg(0), 0)});
+            case Z3_OP_LE:
+                return lessEq(e.arg(0), e.arg(1), 0);
+            case Z3_OP_LT:
+                return lessEq(e.arg(0), e.arg(1), -1);
+            case Z3_OP_GE:
+                return lessEq(e.arg(1), e.arg(0), 0);
+            case Z3_OP_GT:
+                return lessEq(e.arg(1), e.arg(0), -1);
+            default:
+                throw std::runtime_error("Unsupported term: " + e.to_string());
+        }
+    }
+
+   public:
+    DiffLogicTranslator(DiffLogicSolver& solver, z3::context& c)
+        : solver_(solver), c_(c), keep_(c), zero_(solver.newNode()) {}
+
+    /* literal equivalent to the Boolean term e */
+    Lit translate(const z3::expr& e) {
+        auto it = lits_.find(e.id());
+        if (it != lits_.end()) return it->second;
+
+        Lit lit = encode(e);
+        keep_.push_back(e);
+        lits_[e.id()] = lit;
+        return lit;
+    }
+
+    /* adds e as a constraint, a conjunction as one clause per conjunct */
+    void assertFormula(const z3::expr& e) {
+        if (e.is_and()) {
+            for (unsigned i = 0; i < e.num_args(); ++i)
+                assertFormula(e.arg(i));
+            return;
+        }
+
+        std::vector<Lit> clause;
+        if (e.is_or()) {
+            for (unsigned i = 0; i < e.num_args(); ++i)
+                clause.push_back(translate(e.arg(i)));
+        } else {
+            clause.push_back(translate(e));
+        }
+        solver_.addClause(std::move(clause));
+    }
+
+    void assertFormulas(const z3::expr_vector& formulas) {
+        for (const z3::expr& e : formulas) assertFormula(e);
+    }
+
+    /* the last sat model over the constants translated so far */
+    z3::model getModel() {
+        z3::model m(c_);
+        for (auto& [e, node] : int_consts_) {
+            z3::func_decl decl = e.decl();
+            z3::expr value = c_.int_val(solver_.modelValue(node, zero_));
+            m.add_const_interp(decl, value);
+        }
+        for (auto& [e, lit] : bool_consts_) {
+            z3::func_decl decl = e.decl();
+            z3::expr value = c_.bool_val(solver_.modelValue(lit));
+            m.add_const_interp(decl, value);
+        }
+        return m;
+    }
+};
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "event.hpp"
+#include "trace.hpp"
+
+/**
+ * GreedyScheduler builds a witness for a COP without a solver. It runs the
+ * threads of the two events up to right before them, in trace order where it
+ * can, and executes an event only when it is enabled: a read must see the
+ * value it read in the trace, an acquire needs a free lock, a begin its fork
+ * and a join the end of the thread. When every pending thread is blocked it
+ * pulls in more of the trace: the last write before a blocked read, the
+ * release of a lock another thread holds, a missing fork or end. Choices
+ * between enabled threads are revisited by backtracking, up to a budget.
+ */
+class GreedyScheduler {
+   private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    std::vector<Event> events_;
+    std::vector<uint32_t> thread_of_;   // dense thread idx by event idx
+    std::vector<uint32_t> local_idx_;   // 1-based position in the thread
+    std::vector<std::vector<uint32_t>> thread_events_;  // event idxs
+    std::vector<uint32_t> target_of_;   // dense var or lock idx by event idx
+    std::vector<uint32_t> enabler_;     // fork of a begin, end of a join
+    std::vector<uint32_t> last_write_;  // of the var before a read
+    std::vector<uint32_t> release_of_;  // matching release of an acquire
+    std::vector<int64_t> initial_value_;  // by var, -1 if unknown
+    size_t var_count_ = 0;
+    size_t lock_count_ = 0;
+    uint32_t backtrack_budget_;
+
+    /* state of one schedule, undone through the trail on backtracking */
+    struct Undo {
+        enum class Kind { Exec, Need } kind;
+        uint32_t thread;
+        uint32_t slot;      // var or lock idx of an executed event
+        int64_t old_value;  // var value or lock holder before it
+    };
+
+    std::vector<uint32_t> pos_;    // events executed per thread
+    std::vector<uint32_t> need_;   // events to execute per thread
+    std::vector<uint32_t> limit_;  // most events a thread may execute
+    std::vector<int64_t> values_;  // by var, -1 if not written yet
+    std::vector<int64_t> holder_;  // by lock, -1 if free
+    std::vector<Undo> trail_;
+    std::vector<uint32_t> order_;
+
+    bool isEnabled(uint32_t idx) const {
+        const Event& e = events_[idx];
+        switch (e.getEventType()) {
+            case Event::EventType::Read: {
+                int64_t value = values_[target_of_[idx]];
+                if (value < 0) value = initial_value_[target_of_[idx]];
+                return value == static_cast<int64_t>(e.getTargetValue());
+            }
+            case Event::EventType::Acquire:
+                return holder_[target_of_[idx]] < 0;
+            case Event::EventType::Begin:
+            case Event::EventType::Join:
+                return enabler_[idx] == kNone || isExecuted(enabler_[idx]);
+            default:
+                return true;
+        }
+    }
+
+    bool isExecuted(uint32_t idx) const {
+        return pos_[thread_of_[idx]] >= local_idx_[idx];
+    }
+
+    void execute(uint32_t t) {
+        uint32_t idx = thread_events_[t][pos_[t]];
+        const Event& e = events_[idx];
+        Undo undo{Undo::Kind::Exec, t, kNone, 0};
+
+        if (e.getEventType() == Event::EventType::Write) {
+            undo.slot = target_of_[idx];
+            undo.old_value = values_[undo.slot];
+            values_[undo.slot] = e.getTargetValue();
+        } else if (e.getEventType() == Event::EventType::Acquire ||
+                   e.getEventType() == Event::EventType::Release) {
+            undo.slot = target_of_[idx];
+            undo.old_value = holder_[undo.slot];
+            holder_[undo.slot] = e.getEventType() == Event::EventType::Acquire
+                                     ? static_cast<int64_t>(t)
+                                     : -1;
+        }
+
+        pos_[t]++;
+        order_.push_back(e.getEventId());
+        trail_.push_back(undo);
+    }
+
+    /* makes thread t run up to and including event idx */
+    bool raiseNeed(uint32_t idx) {
+        uint32_t t = thread_of_[idx];
+        if (local_idx_[idx] > limit_[t]) return false;
+        if (local_idx_[idx] <= need_[t]) return false;
+
+        trail_.push_back({Undo::Kind::Need, t, kNone, need_[t]});
+        need_[t] = local_idx_[idx];
+        return true;
+    }
+
+    void undoTo(size_t size) {
+        while (trail_.size() > size) {
+            Undo undo = trail_.back();
+            trail_.pop_back();
+
+            if (undo.kind == Undo::Kind::Need) {
+                need_[undo.thread] = static_cast<uint32_t>(undo.old_value);
+                continue;
+            }
+
+            pos_[undo.thread]--;
+            order_.pop_back();
+            uint32_t idx = thread_events_[undo.thread][pos_[undo.thread]];
+            if (undo.slot == kNone) continue;
+            if (events_[idx].getEventType() == Event::EventType::Write)
+                values_[undo.slot] = undo.old_value;
+            else
+                holder_[undo.slot] = undo.old_value;
+        }
+    }
+
+    /* pulls in what a blocked event waits for, false if nothing helps */
+    bool unblock(uint32_t idx) {
+        const Event& e = events_[idx];
+        switch (e.getEventType()) {
+            case Event::EventType::Read:
+                return last_write_[idx] != kNone &&
+                       !isExecuted(last_write_[idx]) &&
+                       raiseNeed(last_write_[idx]);
+            case Event::EventType::Acquire: {
+                int64_t holder = holder_[target_of_[idx]];
+                if (holder < 0) return false;
+                uint32_t acq = thread_events_[holder][pos_[holder] - 1];
+                /* the holder's latest acquire of this lock */
+                for (uint32_t i = pos_[holder]; i-- > 0;) {
+                    acq = thread_events_[holder][i];
+                    if (events_[acq].getEventType() ==
+                            Event::EventType::Acquire &&
+                        target_of_[acq] == target_of_[idx])
+                        break;
+                }
+                return release_of_[acq] != kNone &&
+                       raiseNeed(release_of_[acq]);
+            }
+            case Event::EventType::Begin:
+            case Event::EventType::Join:
+                return enabler_[idx] != kNone && raiseNeed(enabler_[idx]);
+            default:
+                return false;
+        }
+    }
+
+   public:
+    explicit GreedyScheduler(const Trace& trace, uint32_t backtrackBudget = 64)
+        : events_(trace.getAllEvents()), backtrack_budget_(backtrackBudget) {
+        std::unordered_map<uint32_t, uint32_t> tid_to_idx, var_to_idx,
+            lock_to_idx;
+        std::unordered_map<uint32_t, uint32_t> last_write_of_var;
+        std::unordered_map<uint64_t, std::vector<uint32_t>> open_acquires;
+
+        size_t n = events_.size();
+        thread_of_.resize(n);
+        local_idx_.resize(n);
+        target_of_.assign(n, kNone);
+        enabler_.assign(n, kNone);
+        last_write_.assign(n, kNone);
+        release_of_.assign(n, kNone);
+
+        for (uint32_t idx = 0; idx < n; ++idx) {
+            const Event& e = events_[idx];
+            auto [tit, newThread] = tid_to_idx.try_emplace(
+                e.getThreadId(), static_cast<uint32_t>(thread_events_.size()));
+            if (newThread) thread_events_.emplace_back();
+            uint32_t t = tit->second;
+
+            thread_of_[idx] = t;
+            thread_events_[t].push_back(idx);
+            local_idx_[idx] = static_cast<uint32_t>(thread_events_[t].size());
+
+            switch (e.getEventType()) {
+                case Event::EventType::Read:
+                case Event::EventType::Write: {
+                    auto [vit, newVar] = var_to_idx.try_emplace(
+                        e.getTargetId(), static_cast<uint32_t>(var_count_));
+                    if (newVar) {
+                        var_count_++;
+                        initial_value_.push_back(-1);
+                    }
+                    target_of_[idx] = vit->second;
+
+                    auto last = last_write_of_var.find(e.getTargetId());
+                    if (e.getEventType() == Event::EventType::Write) {
+                        last_write_of_var[e.getTargetId()] = idx;
+                    } else if (last != last_write_of_var.end()) {
+                        last_write_[idx] = last->second;
+                    } else {
+                        /* a read before any write sees the initial value */
+                        initial_value_[vit->second] = e.getTargetValue();
+                    }
+                    break;
+                }
+                case Event::EventType::Acquire:
+                case Event::EventType::Release: {
+                    auto [lit, newLock] = lock_to_idx.try_emplace(
+                        e.getTargetId(), static_cast<uint32_t>(lock_count_));
+                    if (newLock) lock_count_++;
+                    target_of_[idx] = lit->second;
+
+                    std::vector<uint32_t>& open = open_acquires
+                        [(static_cast<uint64_t>(t) << 32) | lit->second];
+                    if (e.getEventType() == Event::EventType::Acquire) {
+                        open.push_back(idx);
+                    } else if (!open.empty()) {
+                        release_of_[open.back()] = idx;
+                        open.pop_back();
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        for (const auto& [forkEvent, beginEvent] : trace.getForkBeginPairs())
+            if (!Event::isNullEvent(forkEvent) &&
+                !Event::isNullEvent(beginEvent))
+                enabler_[beginEvent.getEventId() - 1] =
+                    forkEvent.getEventId() - 1;
+        for (const auto& [endEvent, joinEvent] : trace.getEndJoinPairs())
+            if (!Event::isNullEvent(endEvent) && !Event::isNullEvent(joinEvent))
+                enabler_[joinEvent.getEventId() - 1] = endEvent.getEventId() - 1;
+    }
+
+    /* a witness prefix followed by e1 and e2, false if none was found */
+    bool schedule(const Event& e1, const Event& e2,
+                  std::vector<uint32_t>& witness) {
+        size_t threads = thread_events_.size();
+        pos_.assign(threads, 0);
+        need_.assign(threads, 0);
+        limit_.assign(threads, UINT32_MAX);
+        values_.assign(var_count_, -1);
+        holder_.assign(lock_count_, -1);
+        trail_.clear();
+        order_.clear();
+
+        /* neither event itself may run */
+        for (const Event* e : {&e1, &e2}) {
+            uint32_t idx = e->getEventId() - 1;
+            limit_[thread_of_[idx]] = local_idx_[idx] - 1;
+            need_[thread_of_[idx]] = local_idx_[idx] - 1;
+        }
+
+        struct Choice {
+            size_t trail_size;
+            std::vector<uint32_t> threads;
+            size_t next;
+        };
+        std::vector<Choice> choices;
+        uint32_t backtracks = 0;
+        std::vector<uint32_t> enabled;
+
+        while (true) {
+            enabled.clear();
+            bool pending = false;
+            for (uint32_t t = 0; t < threads; ++t) {
+                if (pos_[t] >= need_[t]) continue;
+                pending = true;
+                if (isEnabled(thread_events_[t][pos_[t]])) enabled.push_back(t);
+            }
+
+            if (!pending) break;
+
+            if (enabled.empty()) {
+                bool progress = false;
+                for (uint32_t t = 0; t < threads; ++t) {
+                    if (pos_[t] < need_[t])
+                        progress |= unblock(thread_events_[t][pos_[t]]);
+                }
+                if (progress) continue;
+
+                /* take the next alternative of the latest open choice */
+                while (!choices.empty() &&
+                       choices.back().next >= choices.back().threads.size())
+                    choices.pop_back();
+                if (choices.empty() || backtracks++ >= backtrack_budget_)
+                    return false;
+
+                Choice& choice = choices.back();
+                undoTo(choice.trail_size);
+                execute(choice.threads[choice.next++]);
+                continue;
+            }
+
+            /* the trace order first, the other threads on backtracking */
+            std::sort(enabled.begin(), enabled.end(),
+                      [this](uint32_t a, uint32_t b) {
+                          return thread_events_[a][pos_[a]] <
+                                 thread_events_[b][pos_[b]];
+                      });
+            if (enabled.size() > 1)
+                choices.push_back({trail_.size(), enabled, 1});
+            execute(enabled[0]);
+        }
+
+        witness = order_;
+        bool inOrder = e1.getEventId() < e2.getEventId();
+        witness.push_back(inOrder ? e1.getEventId() : e2.getEventId());
+        witness.push_back(inOrder ? e2.getEventId() : e1.getEventId());
+        return true;
+    }
+};
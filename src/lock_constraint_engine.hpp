@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "event.hpp"
+#include "lock_region.hpp"
+#include "thread.hpp"
+#include "trace.hpp"
+#include "transitive_closure.hpp"
+
+/**
+ * LockConstraintEngine decides which pairs of lock regions need a mutual
+ * exclusion constraint. The regions of each lock are swept in trace order
+ * while keeping, per thread, the regions seen so far (the thread's frontier).
+ * For a new region, the frontier of every other thread is walked backwards
+ * until a region that must happen before it is found; every older region of
+ * that thread is then ordered as well through program order.
+ *
+ * A surviving pair is still skipped when both regions are nested inside
+ * regions of a common other lock, since the mutual exclusion of the outer
+ * regions already orders the inner ones.
+ */
+class LockConstraintEngine {
+   public:
+    struct Stats {
+        uint64_t total_pairs = 0;     // cross thread region pairs
+        uint64_t pairwise_pairs = 0;  // pairs the pairwise generator emits
+        uint64_t nested_pairs = 0;    // pairs implied by an enclosing lock
+        uint64_t emitted_pairs = 0;
+    };
+
+   private:
+    const Trace& trace_;
+    const TransitiveClosure& mhb_closure_;
+
+    /* acquire event id -> (lock id, acquire event id) of enclosing regions */
+    std::unordered_map<EID, std::vector<std::pair<uint32_t, EID>>>
+        enclosing_regions_;
+
+    Stats stats_;
+
+    void computeEnclosingRegions() {
+        std::unordered_set<EID> released_acqs;
+
+        for (const Thread& thread : trace_.getThreads()) {
+            std::unordered_map<uint32_t, Event> open_acqs;
+            std::unordered_map<EID, std::vector<std::pair<uint32_t, EID>>>
+                open_at_acq;
+
+            for (const Event& e : thread.getEvents()) {
+                if (e.getEventType() == Event::EventType::Acquire) {
+                    std::vector<std::pair<uint32_t, EID>>& outer =
+                        open_at_acq[e.getEventId()];
+                    for (const auto& [lockId, acq] : open_acqs)
+                        outer.emplace_back(lockId, acq.getEventId());
+                    open_acqs[e.getTargetId()] = e;
+                } else if (e.getEventType() == Event::EventType::Release) {
+                    auto it = open_acqs.find(e.getTargetId());
+                    if (it == open_acqs.end()) continue;
+
+                    EID acqId = it->second.getEventId();
+                    open_acqs.erase(it);
+                    released_acqs.insert(acqId);
+
+                    /* an outer region has to stay open until this release */
+                    std::vector<std::pair<uint32_t, EID>> enclosing;
+                    for (const auto& [lockId, outerAcq] : open_at_acq[acqId]) {
+                        auto open = open_acqs.find(lockId);
+                        if (open != open_acqs.end() &&
+                            open->second.getEventId() == outerAcq)
+                            enclosing.emplace_back(lockId, outerAcq);
+                    }
+                    if (!enclosing.empty())
+                        enclosing_regions_[acqId] = std::move(enclosing);
+                }
+            }
+        }
+
+        /* an outer region that is never released has no constraints of its
+         * own, so it cannot imply anything about the inner regions */
+        for (auto& [_, enclosing] : enclosing_regions_) {
+            enclosing.erase(
+                std::remove_if(enclosing.begin(), enclosing.end(),
+                               [&released_acqs](const auto& outer) {
+                                   return released_acqs.find(outer.second) ==
+                                          released_acqs.end();
+                               }),
+                enclosing.end());
+        }
+    }
+
+    bool hasCommonEnclosingLock(const LockRegion& lr1,
+                                const LockRegion& lr2) const {
+        auto it1 = enclosing_regions_.find(lr1.getAcqEvent().getEventId());
+        auto it2 = enclosing_regions_.find(lr2.getAcqEvent().getEventId());
+        if (it1 == enclosing_regions_.end() || it2 == enclosing_regions_.end())
+            return false;
+
+        for (const auto& outer1 : it1->second) {
+            for (const auto& outer2 : it2->second) {
+                if (outer1.first == outer2.first) return true;
+            }
+        }
+        return false;
+    }
+
+   public:
+    LockConstraintEngine(const Trace& trace,
+                         const TransitiveClosure& mhb_closure)
+        : trace_(trace), mhb_closure_(mhb_closure) {
+        computeEnclosingRegions();
+    }
+
+    /**
+     * Returns the region pairs that need a mutual exclusion constraint. The
+     * first region of each pair precedes the second one in the trace.
+     */
+    std::vector<std::pair<LockRegion, LockRegion>> generate() {
+        std::vector<std::pair<LockRegion, LockRegion>> pairs;
+
+        for (const auto& [lockId, lockRegions] : trace_.getLockRegions()) {
+            std::unordered_map<uint32_t, std::vector<size_t>> frontier;
+
+            for (size_t j = 0; j < lockRegions.size(); ++j) {
+                const LockRegion& lr2 = lockRegions[j];
+
+                for (const auto& [tid, seen] : frontier) {
+                    if (tid == lr2.getRegionThreadId()) continue;
+
+                    stats_.total_pairs += seen.size();
+
+                    for (auto it = seen.rbegin(); it != seen.rend(); ++it) {
+                        const LockRegion& lr1 = lockRegions[*it];
+
+                        /* regions are swept in trace order so lr2 can never
+                         * be ordered before lr1 */
+                        if (mhb_closure_.happensBefore(lr1.getRelEvent(),
+                                                       lr2.getAcqEvent()))
+                            break;
+
+                        stats_.pairwise_pairs++;
+
+                        if (hasCommonEnclosingLock(lr1, lr2)) {
+                            stats_.nested_pairs++;
+                            continue;
+                        }
+
+                        stats_.emitted_pairs++;
+                        pairs.emplace_back(lr1, lr2);
+                    }
+                }
+
+                frontier[lr2.getRegionThreadId()].push_back(j);
+            }
+        }
+
+        return pairs;
+    }
+
+    const Stats& getStats() const { return stats_; }
+};
@@ -1,12 +1,12 @@
 #include "model_logger.hpp"
 
 #include "BSlogger.hpp"
+#include "z3_term_cache.hpp"
 
-void ModelLogger::logWitnessPrefix(const z3::model& m, const Event& e1,
-                                   const Event& e2) {
-    LOG_INIT_COUT();
-    std::vector<Event> events = trace_.getAllEvents();
-    std::vector<std::pair<std::string, int>> event_order;
+std::vector<uint32_t> ModelLogger::witnessFromModel(const z3::model& m,
+                                                    const Event& e1,
+                                                    const Event& e2) const {
+    std::vector<std::pair<EID, int>> event_order;
     int e1Idx, e2Idx;
 
     std::unordered_map<uint32_t, uint32_t> firstInfeasibleEventInThread;
@@ -18,12 +18,15 @@ void ModelLogger::logWitnessPrefix(const z3::model& m, const Event& e1,
     for (unsigned i = 0; i < m.size(); ++i) {
         z3::func_decl v = m[static_cast<int>(i)];
 
-        if (v.name().str().substr(0, 3) == "phi") {
+        /* only the order and phi variables of events make up the witness */
+        EID eid;
+        Z3TermCache::Kind kind;
+        if (!Z3TermCache::decode(v, eid, kind)) continue;
+
+        if (kind == Z3TermCache::Kind::Phi) {
             z3::expr value = m.get_const_interp(v);
             assert(value.is_bool());
 
-            std::string name = v.name().str().substr(4);
-            uint32_t eid = static_cast<uint32_t>(std::stoul(name));
             Event e = trace_.getEvent(eid);
 
             if (value.bool_value() == 1)
@@ -36,40 +39,28 @@ void ModelLogger::logWitnessPrefix(const z3::model& m, const Event& e1,
                 eid = trace_.getThread(e.getThreadId()).getPrevAcq(e).getEventId();
             
             firstInfeasibleEventInThread[e.getThreadId()] = std::min(eid, firstInfeasibleEventInThread[e.getThreadId()]);
+            continue;
         }
 
-        // log(LOG_INFO) << firstInfeasibleEventInThread[1] << "\n";
-
-        if (!v.range().is_int()) continue;
-
         z3::expr value = m.get_const_interp(v);
         assert(value.is_int());
 
-        std::string name =
-            v.name().str().substr(2);  // "order variables start with e_"
-
-        if (name == std::to_string(e1.getEventId())) {
+        if (eid == e1.getEventId()) {
             e1Idx = value.get_numeral_int();
-        } else if (name == std::to_string(e2.getEventId())) {
+        } else if (eid == e2.getEventId()) {
             e2Idx = value.get_numeral_int();
         }
 
-        event_order.push_back({name, value.get_numeral_int()});
+        event_order.push_back({eid, value.get_numeral_int()});
     }
 
     std::sort(event_order.begin(), event_order.end(),
-              [](const std::pair<std::string, int>& a,
-                 const std::pair<std::string, int>& b) {
+              [](const std::pair<EID, int>& a, const std::pair<EID, int>& b) {
                   return a.second < b.second;
               });
 
-    log_file_ << "Witness for: e" << e1.getEventId() << " - e"
-              << e2.getEventId() << "\n";
-
-    int j = 1;
     std::vector<uint32_t> witness;
-    for (const auto& [name, order] : event_order) {
-        uint32_t eid = static_cast<uint32_t>(std::stoul(name));
+    for (const auto& [eid, order] : event_order) {
         Event e = trace_.getEvent(eid);
 
         assert(firstInfeasibleEventInThread.find(e.getThreadId()) != firstInfeasibleEventInThread.end());
@@ -80,32 +71,35 @@ void ModelLogger::logWitnessPrefix(const z3::model& m, const Event& e1,
         if (order > e1Idx || order > e2Idx) break;
         if (eid == e1.getEventId() || eid == e2.getEventId()) continue;
 
-        if (log_binary_witness_)
-            witness.push_back(static_cast<uint32_t>(std::stoul(name)));
-        log_file_ << j++ << ": e" << name << " - " << events[eid-1].prettyString()
-                  << "\n";
+        witness.push_back(eid);
     }
 
     if (e1Idx < e2Idx) {
-        if (log_binary_witness_) {
-            witness.push_back(e1.getEventId());
-            witness.push_back(e2.getEventId());
-        }
-        
-        log_file_ << j++ << ": e" << e1.getEventId() << " - "
-                  << e1.prettyString() << "\n";
-        log_file_ << j++ << ": e" << e2.getEventId() << " - "
-                  << e2.prettyString() << "\n";
+        witness.push_back(e1.getEventId());
+        witness.push_back(e2.getEventId());
     } else {
-        if (log_binary_witness_) {
-            witness.push_back(e2.getEventId());
-            witness.push_back(e1.getEventId());
-        }
-        
-        log_file_ << j++ << ": e" << e2.getEventId() << " - "
-                  << e2.prettyString() << "\n";
-        log_file_ << j++ << ": e" << e1.getEventId() << " - "
-                  << e1.prettyString() << "\n";
+        witness.push_back(e2.getEventId());
+        witness.push_back(e1.getEventId());
+    }
+
+    return witness;
+}
+
+void ModelLogger::logWitness(const std::vector<uint32_t>& witness,
+                             const Event& e1, const Event& e2) {
+    if (queue_ && queue_->push({witness, e1, e2})) return;
+    writeWitness(witness, e1, e2);
+}
+
+void ModelLogger::writeWitness(const std::vector<uint32_t>& witness,
+                               const Event& e1, const Event& e2) {
+    log_file_ << "Witness for: e" << e1.getEventId() << " - e"
+              << e2.getEventId() << "\n";
+
+    int j = 1;
+    for (uint32_t eid : witness) {
+        log_file_ << j++ << ": e" << eid << " - "
+                  << trace_.getEvent(eid).prettyString() << "\n";
     }
 
     if (log_binary_witness_) {
@@ -119,6 +113,11 @@ void ModelLogger::logWitnessPrefix(const z3::model& m, const Event& e1,
     log_file_ << "------------------------------------------------------\n";
 }
 
+void ModelLogger::logWitnessPrefix(const z3::model& m, const Event& e1,
+                                   const Event& e2) {
+    logWitness(witnessFromModel(m, e1, e2), e1, e2);
+}
+
 std::vector<std::vector<uint32_t>> ModelLogger::readBinaryWitness(
     const std::string& file_path) {
     std::ifstream file(file_path, std::ios::binary);
@@ -128,8 +127,8 @@ std::vector<std::vector<uint32_t>> ModelLogger::readBinaryWitness(
 
     std::vector<std::vector<uint32_t>> witnesses;
     while (file.peek() != EOF) {
-        uint32_t size;
-        file.read(reinterpret_cast<char*>(&size), sizeof(uint32_t));
+        size_t size;
+        file.read(reinterpret_cast<char*>(&size), sizeof(size_t));
         std::vector<uint32_t> witness(size);
         file.read(reinterpret_cast<char*>(witness.data()),
                   size * sizeof(uint32_t));
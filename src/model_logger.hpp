@@ -3,20 +3,50 @@
 
 #include <filesystem>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <thread>
 
 #include "BSlogger.hpp"
+#include "bounded_queue.hpp"
 #include "trace.hpp"
 
+/**
+ * ModelLogger writes the witnesses of the races found. With a writer queue
+ * the witnesses are formatted and written on a thread of their own, so the
+ * solver goes on with the next COP while the last witness is written out;
+ * the queue holds at most that many witnesses in flight.
+ */
 class ModelLogger {
+   public:
+    struct WriterStats {
+        uint64_t witnesses = 0;   // handed to the writer thread
+        uint64_t full_waits = 0;  // times the solver found the queue full
+    };
+
    private:
+    struct PendingWitness {
+        std::vector<uint32_t> witness;
+        Event e1;
+        Event e2;
+    };
+
     Trace& trace_;
     bool log_binary_witness_;
     std::ofstream log_file_;
     std::ofstream binary_log_file_;
 
+    std::unique_ptr<BoundedQueue<PendingWitness>> queue_;
+    std::thread writer_;
+    WriterStats writer_stats_;
+
+    void writeWitness(const std::vector<uint32_t>& witness, const Event& e1,
+                      const Event& e2);
+
    public:
-    ModelLogger(Trace& trace, const std::string& log_file_path, bool log_binary_witness)
+    /* writerQueue 0 writes every witness on the caller's thread */
+    ModelLogger(Trace& trace, const std::string& log_file_path,
+                bool log_binary_witness, size_t writerQueue = 0)
         : trace_(trace), log_binary_witness_(log_binary_witness) {
         std::filesystem::path log_path(log_file_path);
         std::filesystem::path dir = log_path.parent_path();
@@ -37,12 +67,42 @@ class ModelLogger {
         if (!binary_log_file_.is_open()) {
             throw std::runtime_error("Failed to open binary log file");
         }
+
+        if (writerQueue) {
+            queue_ = std::make_unique<BoundedQueue<PendingWitness>>(writerQueue);
+            writer_ = std::thread([this]() {
+                PendingWitness pending;
+                while (queue_->pop(pending))
+                    writeWitness(pending.witness, pending.e1, pending.e2);
+            });
+        }
     }
 
     ~ModelLogger() {
+        finish();
         if (log_file_.is_open()) log_file_.close();
     }
 
+    /* waits for the witnesses still queued to be written */
+    void finish() {
+        if (!writer_.joinable()) return;
+        queue_->close();
+        writer_.join();
+
+        BoundedQueue<PendingWitness>::Stats stats = queue_->getStats();
+        writer_stats_ = {stats.pushed, stats.full_waits};
+    }
+
+    /* valid once finish returned */
+    const WriterStats& getWriterStats() const { return writer_stats_; }
+
+    /* events of the model up to the race, ending with the racing pair */
+    std::vector<uint32_t> witnessFromModel(const z3::model& m, const Event& e1,
+                                           const Event& e2) const;
+
+    void logWitness(const std::vector<uint32_t>& witness, const Event& e1,
+                    const Event& e2);
+
     void logWitnessPrefix(const z3::model& m, const Event& e1, const Event& e2);
 
     static std::vector<std::vector<uint32_t>> readBinaryWitness(
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "event.hpp"
+
+/**
+ * PhiClause is one way for a read to observe its value in a reordering:
+ * either from the initial value (null source) or from a source write. A
+ * clause holds when all its order atoms hold, the phi of every listed read
+ * holds, and (if check_bad_writes is set) no bad write of the read falls
+ * between the source and the read.
+ */
+struct PhiClause {
+    Event source;
+    std::vector<std::pair<Event, Event>> order;  // first < second
+    std::vector<Event> phi_reads;
+    bool check_bad_writes = false;
+};
+
+/**
+ * PhiDef is the intermediate representation of phi_conc of a read, built and
+ * constant folded before any Z3 term is created. Only residue definitions
+ * are encoded; references to folded reads are replaced by their constant.
+ */
+struct PhiDef {
+    enum class Kind { False, True, Residue };
+
+    Kind kind = Kind::Residue;
+    bool building = true;
+    bool same_as_prev = false;  // phi_sc folded to true, phi_conc is phi_abs
+
+    Event read;
+    Event prev_read;                // phi_abs, null when there is none
+    std::vector<PhiClause> clauses;  // phi_sc, disjunction of the clauses
+    std::vector<Event> bad_writes;   // bad writes left after filtering
+};
+
+struct PhiFoldStats {
+    uint64_t reads = 0;
+    uint64_t true_reads = 0;
+    uint64_t false_reads = 0;
+    uint64_t aliased_reads = 0;  // residue reads equal to their phi_abs
+    uint64_t clauses = 0;
+    uint64_t folded_clauses = 0;  // clauses dropped or found to be true
+    uint64_t refuted_cops = 0;    // COPs with a phi_abs folded to false
+};
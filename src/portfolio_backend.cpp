@@ -0,0 +1,167 @@
+#include "portfolio_backend.hpp"
+
+#include <chrono>
+#include <sstream>
+
+#include "BSlogger.hpp"
+
+PortfolioBackend::PortfolioBackend(z3::context& c,
+                                   const std::vector<Z3Config>& configs)
+    : c_(c) {
+    stats_.wins.assign(configs.size(), 0);
+    for (const Z3Config& config : configs)
+        members_.push_back(std::make_unique<Member>(config));
+
+    for (size_t i = 0; i < members_.size(); ++i)
+        members_[i]->thread =
+            std::thread(&PortfolioBackend::run, this, std::ref(*members_[i]),
+                        static_cast<int>(i));
+}
+
+PortfolioBackend::~PortfolioBackend() {
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        shutdown_ = true;
+    }
+    start_.notify_all();
+    for (auto& member : members_) member->thread.join();
+}
+
+void PortfolioBackend::run(Member& member, int idx) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [&] { return shutdown_ || round_ != seen; });
+            if (shutdown_) return;
+            seen = round_;
+            member.interrupted = false;
+        }
+
+        z3::check_result result = z3::unknown;
+        bool late = true;
+        try {
+            Instance& instance = *member.instance;
+            if (!instance.warm) instance.s.check();
+            instance.warm = true;
+
+            /* a member that starts after the race is decided sits it out */
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                late = winner_ >= 0 || expired_;
+                member.checking = !late;
+            }
+            if (!late) result = instance.s.check(instance.assumptions);
+        } catch (...) {
+            member.error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> guard(mutex_);
+        member.result = result;
+        member.checking = false;
+        if (result != z3::unknown && winner_ < 0 && !member.interrupted)
+            winner_ = idx;
+        pending_--;
+        done_.notify_all();
+    }
+}
+
+void PortfolioBackend::add(const z3::expr& e) {
+    /* the workers are idle between checks, so their contexts are free */
+    for (auto& member : members_) {
+        Instance& instance = *member->instance;
+        z3::expr translated =
+            z3::to_expr(instance.c, Z3_translate(c_, e, instance.c));
+        instance.s.add(translated);
+    }
+}
+
+SolverBackend::Answer PortfolioBackend::check(
+    const z3::expr_vector& assumptions) {
+    for (auto& member : members_) {
+        Instance& instance = *member->instance;
+        instance.assumptions = z3::expr_vector(instance.c, assumptions);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        pending_ = members_.size();
+        winner_ = -1;
+        expired_ = false;
+        round_++;
+        start_.notify_all();
+
+        /* only members inside their check are interrupted, once there is a
+         * winner or the time is up. An interrupt that lands just before the
+         * check starts is lost, so it is repeated until every member has
+         * given up */
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(timeout_);
+        while (pending_) {
+            if (winner_ < 0 && !expired_) {
+                if (!timeout_)
+                    done_.wait(lock);
+                else if (done_.wait_until(lock, deadline) ==
+                         std::cv_status::timeout)
+                    expired_ = winner_ < 0;
+                continue;
+            }
+            for (auto& member : members_) {
+                if (!member->checking) continue;
+                member->instance->c.interrupt();
+                if (!member->interrupted) stats_.interrupts++;
+                member->interrupted = true;
+            }
+            done_.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+
+    for (auto& member : members_) {
+        if (member->error) std::rethrow_exception(member->error);
+    }
+
+    stats_.checks++;
+    Answer answer;
+    if (winner_ < 0) {
+        stats_.unknown++;
+        return answer;
+    }
+
+    Instance& winner = *members_[winner_]->instance;
+    stats_.wins[winner_]++;
+    if (members_[winner_]->result == z3::sat) {
+        answer.result = Result::Sat;
+        z3::model m = winner.s.get_model();
+        answer.model = z3::model(m, c_, z3::model::translate());
+    } else {
+        answer.result = Result::Unsat;
+        for (const z3::expr& lit : winner.s.unsat_core()) {
+            for (unsigned i = 0; i < winner.assumptions.size(); ++i)
+                if (z3::eq(lit, winner.assumptions[i]))
+                    answer.core.push_back(i);
+        }
+    }
+    return answer;
+}
+
+void PortfolioBackend::logStats() const {
+    LOG_INIT_COUT();
+
+    size_t best = 0;
+    std::ostringstream wins;
+    for (size_t i = 0; i < members_.size(); ++i) {
+        wins << (i ? ", " : " ") << members_[i]->config.name << " "
+             << stats_.wins[i];
+        if (stats_.wins[i] > stats_.wins[best]) best = i;
+    }
+
+    log(LOG_INFO) << "Portfolio: " << stats_.checks << " checks ("
+                  << stats_.unknown << " unknown, " << stats_.interrupts
+                  << " checks interrupted), wins per "
+                     "configuration:"
+                  << wins.str() << "\n";
+    if (!members_.empty())
+        log(LOG_INFO) << "Portfolio: " << members_[best]->config.name
+                      << " won most often, pin it with --z3-config "
+                      << members_[best]->config.name << "\n";
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <z3++.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "solver_backend.hpp"
+#include "z3_configs.hpp"
+
+/**
+ * PortfolioBackend races differently configured Z3 solvers on every check.
+ * Each configuration has its own context, solver and thread, holding a
+ * translated copy of the base. A check is handed to all of them, the first
+ * sat or unsat answer is taken and the other contexts are interrupted. The
+ * wins per configuration are counted so that the best one can be pinned.
+ */
+class PortfolioBackend : public SolverBackend {
+   public:
+    struct Stats {
+        uint64_t checks = 0;
+        uint64_t unknown = 0;
+        uint64_t interrupts = 0;
+        std::vector<uint64_t> wins;  // by configuration
+    };
+
+   private:
+    /* a context with the solver of one configuration. The losers of every
+     * race are interrupted, which the QF_IDL solver does not come through
+     * with its answers intact, so it is the plain SMT solver; that one
+     * takes in the base in an untimed check before its first race, as an
+     * interrupt in the middle of that goes wrong too */
+    struct Instance {
+        z3::context c;
+        z3::solver s;
+        z3::expr_vector assumptions;
+        bool warm = false;  // the base went through an untimed check
+
+        explicit Instance(const Z3Config& config)
+            : c(), s(c, z3::solver::simple()), assumptions(c) {
+            applyZ3Config(s, config);
+        }
+    };
+
+    struct Member {
+        Z3Config config;
+        std::unique_ptr<Instance> instance;
+        z3::check_result result = z3::unknown;
+        bool checking = false;
+        bool interrupted = false;
+        std::exception_ptr error;
+        std::thread thread;
+
+        explicit Member(const Z3Config& config)
+            : config(config), instance(std::make_unique<Instance>(config)) {}
+    };
+
+    z3::context& c_;
+    std::vector<std::unique_ptr<Member>> members_;
+
+    /* guards the round state below and the flags of the members */
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    uint64_t round_ = 0;
+    size_t pending_ = 0;
+    int winner_ = -1;
+    bool expired_ = false;  // the round ran out of time without a winner
+    bool shutdown_ = false;
+    unsigned timeout_ = 0;
+
+    Stats stats_;
+
+    void run(Member& member, int idx);
+
+   public:
+    PortfolioBackend(z3::context& c, const std::vector<Z3Config>& configs);
+    ~PortfolioBackend() override;
+
+    void add(const z3::expr& e) override;
+    Answer check(const z3::expr_vector& assumptions) override;
+
+    void setTimeout(unsigned ms) override { timeout_ = ms; }
+
+    const Stats& getStats() const { return stats_; }
+
+    void logStats() const override;
+};
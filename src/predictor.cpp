@@ -8,6 +8,7 @@
 #include "cmd_argument_parser.cpp"
 #include "trace.hpp"
 #include "model_logger.hpp"
+#include "window_analyzer.hpp"
 
 void printMemoryUsage() {
     struct rusage usage;
@@ -27,7 +28,7 @@ void printMemoryUsage() {
 int main(int argc, char* argv[]) {
     LOG_INIT_COUT();
     try {
-        auto start = std::chrono::high_resolution_clock::now();
+        auto start = std::chrono::steady_clock::now();
 
         Arguments args = Arguments::fromArgs(argc, argv);
 
@@ -38,13 +39,94 @@ int main(int argc, char* argv[]) {
                           ? Trace::fromBinaryFile(args.executionTrace)
                           : Trace::fromTextFile(args.executionTrace);
 
-        ModelLogger logger(trace, witnessPath, args.logBinaryWitness);
+        /* witnesses are written by a thread of their own, fed through a
+         * bounded queue while the solver goes on */
+        ModelLogger logger(trace, witnessPath, args.logBinaryWitness,
+                           args.logWitness ? args.witnessQueue : 0);
 
-        CasualModel model(trace, logger, args.logWitness);
+        ModelOptions options;
+        options.log_witness = args.logWitness;
+        options.sweep_lock_constraints = args.sweepLockConstraints;
+        options.rf_encoding = args.rfEncoding == "selector"
+                                  ? RFEncoding::Selector
+                                  : RFEncoding::Pairwise;
+        options.phi_threads = args.phiThreads;
+        options.solver_threads = args.solverThreads;
+        options.worker_processes = args.workerProcesses;
+        options.shard_size = args.shardSize;
+        options.batch_size = args.batchSize;
+        options.shb_tier = args.shbTier;
+        options.greedy_schedules = args.greedySchedules;
+        options.saturation = args.saturation;
+        if (args.solver == "dl")
+            options.solver = SolverKind::DiffLogic;
+        else if (args.solver == "smtlib")
+            options.solver = SolverKind::SmtLib;
+        else
+            options.solver = SolverKind::Z3;
+        options.smt_solver = args.smtSolver;
+        options.smt_batch = args.smtBatch;
+        options.smt_dir = args.smtDir;
+        options.z3_config = args.z3Config;
+        options.portfolio_size = args.portfolio;
+        options.cop_timeout = args.copTimeout;
+        options.cop_retries = args.copRetries;
+        options.time_budget = args.timeBudget;
+        options.cop_order = args.copOrder == "cost" ? COPOrder::Cost
+                                                    : COPOrder::Trace;
+        options.sample_size = args.sample;
+        options.sample_seed = args.sampleSeed;
+        options.sample_regions = args.sampleRegions;
+        options.encode_on_demand = args.encodeOnDemand;
+        options.term_budget = args.termBudget;
+        options.unsat_cores = args.unsatCores;
+        options.confirm_window = args.confirmWindow;
+        if (args.sample && (args.maxNoOfCOP || args.maxNoOfRace))
+            log(LOG_WARN) << "-c and -r are ignored when sampling, the sample "
+                             "size bounds the checks\n";
+        if (args.solveMode == "sliced")
+            options.solve_mode = SolveMode::Sliced;
+        else if (args.solveMode == "lazy")
+            options.solve_mode = SolveMode::Lazy;
+        else
+            options.solve_mode = SolveMode::Global;
 
-        uint32_t race_count = model.solve(args.maxNoOfCOP, args.maxNoOfRace);
+        uint32_t race_count;
+        if (args.windowSize) {
+            if (args.logWitness)
+                log(LOG_WARN) << "Witnesses are not logged in windowed mode\n";
+            if (args.sample) {
+                log(LOG_WARN) << "Sampling is not supported in windowed mode\n";
+                options.sample_size = 0;
+            }
 
-        auto end = std::chrono::high_resolution_clock::now();
+            WindowOptions windowOptions;
+            windowOptions.window_size = args.windowSize;
+            windowOptions.overlap = args.windowOverlap;
+            windowOptions.threads = args.windowThreads;
+
+            WindowAnalyzer analyzer(trace, logger, options, windowOptions);
+            race_count = analyzer.solve(args.maxNoOfCOP, args.maxNoOfRace);
+        } else {
+            CasualModel model(trace, logger, options);
+            race_count = model.solve(args.maxNoOfCOP, args.maxNoOfRace);
+            if (model.getFirstRaceTime())
+                log(LOG_INFO)
+                    << "Time to first race: "
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(
+                           *model.getFirstRaceTime() - start)
+                           .count()
+                    << "ms\n";
+        }
+
+        logger.finish();
+        if (args.logWitness && args.witnessQueue)
+            log(LOG_INFO) << "Witness writer: "
+                          << logger.getWriterStats().witnesses
+                          << " witnesses written, the queue was full "
+                          << logger.getWriterStats().full_waits << " times\n";
+
+        auto end = std::chrono::steady_clock::now();
 
         log(LOG_INFO) << "No of races predicted: " << race_count << "\n";
         log(LOG_INFO) << "Time taken: "
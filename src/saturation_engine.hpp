@@ -0,0 +1,368 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "event.hpp"
+#include "lock_region.hpp"
+#include "trace.hpp"
+
+/**
+ * SaturationEngine refutes COPs by closing the must order of the model
+ * instead of solving it. Starting from the must happen before edges, it
+ * applies two rules until a fixpoint:
+ *  - lock: for critical sections A and B on the same lock, acq(A) < rel(B)
+ *    forces rel(A) < acq(B);
+ *  - reads from: a read whose phi is required and that has a single write
+ *    left to read from (one not ordered after it) is ordered after that
+ *    write, each write with another value goes before the write or after the
+ *    read, and the reads before the write become required too.
+ * The reads before the two events of the COP are required, as phi_abs of
+ * both is part of the race query. The COP is refuted once its events are
+ * ordered, or a required read has nothing left to read from. Every derived
+ * edge also holds in the original trace, so edges always point forward in
+ * trace order and one pass in trace order computes the clocks. That pass is
+ * made once, for the edges every COP shares; a COP's own edges are then
+ * propagated from their targets only, in trace order, as far as they change
+ * a clock.
+ */
+class SaturationEngine {
+   public:
+    struct Stats {
+        uint64_t cops = 0;
+        uint64_t refuted = 0;
+        uint64_t rounds = 0;
+        uint64_t derived_edges = 0;
+    };
+
+   private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    std::vector<Event> events_;
+    std::vector<uint32_t> thread_of_;  // dense thread idx by event idx
+    std::vector<uint32_t> local_idx_;  // 1-based position in the thread
+    std::vector<std::vector<uint32_t>> thread_events_;
+    size_t thread_count_ = 0;
+
+    std::vector<std::vector<uint32_t>> base_preds_;  // mhb and base lock edges
+    std::vector<std::vector<uint32_t>> base_succs_;
+    std::vector<uint32_t> base_clocks_;
+    std::vector<std::pair<uint32_t, uint32_t>> lock_pairs_;  // acq idxs
+    std::vector<uint32_t> release_of_;
+
+    /* writes of the read's variable by value, built on first use */
+    struct ReadWrites {
+        bool ready = false;
+        bool initial = false;  // may read the initial value
+        std::vector<uint32_t> good;
+        std::vector<uint32_t> bad;
+    };
+    std::vector<ReadWrites> read_writes_;
+    const Trace& trace_;
+
+    /* per COP state */
+    std::vector<std::vector<uint32_t>> extra_preds_;
+    std::vector<std::vector<uint32_t>> extra_succs_;
+    std::vector<uint32_t> touched_;  // events with extra preds or succs
+    std::vector<uint32_t> clocks_;  // event idx * thread_count_ + thread idx
+    std::vector<uint32_t> required_;  // reads up to this local idx, by thread
+
+    /* events whose clock needs recomputing, smallest idx first */
+    std::priority_queue<uint32_t, std::vector<uint32_t>,
+                        std::greater<uint32_t>>
+        pending_;
+    std::vector<uint8_t> queued_;
+    std::vector<uint32_t> updated_;  // events whose clock left the base one
+    std::vector<uint8_t> is_updated_;
+    std::vector<uint32_t> scratch_;
+
+    Stats stats_;
+
+    inline bool before(uint32_t x, uint32_t y) const {
+        return x != y && local_idx_[x] <= clocks_[y * thread_count_ +
+                                                  thread_of_[x]];
+    }
+
+    void computeClocks() {
+        for (uint32_t idx = 0; idx < events_.size(); ++idx) {
+            uint32_t t = thread_of_[idx];
+            uint32_t* own = &clocks_[idx * thread_count_];
+
+            if (local_idx_[idx] > 1) {
+                const uint32_t* prev =
+                    &clocks_[thread_events_[t][local_idx_[idx] - 2] *
+                             thread_count_];
+                std::copy(prev, prev + thread_count_, own);
+            } else {
+                std::fill(own, own + thread_count_, 0);
+            }
+
+            for (const std::vector<uint32_t>* preds :
+                 {&base_preds_[idx], &extra_preds_[idx]}) {
+                for (uint32_t pred : *preds) {
+                    const uint32_t* other = &clocks_[pred * thread_count_];
+                    for (size_t i = 0; i < thread_count_; ++i)
+                        own[i] = std::max(own[i], other[i]);
+                }
+            }
+
+            own[t] = local_idx_[idx];
+        }
+    }
+
+    void schedule(uint32_t idx) {
+        if (queued_[idx]) return;
+        queued_[idx] = 1;
+        pending_.push(idx);
+    }
+
+    /* every pred of an event comes before it in trace order, so once the
+     * smallest pending event is taken all its preds are up to date */
+    void propagate() {
+        while (!pending_.empty()) {
+            uint32_t idx = pending_.top();
+            pending_.pop();
+            queued_[idx] = 0;
+
+            uint32_t t = thread_of_[idx];
+            uint32_t* own = &clocks_[idx * thread_count_];
+            if (local_idx_[idx] > 1) {
+                const uint32_t* prev =
+                    &clocks_[thread_events_[t][local_idx_[idx] - 2] *
+                             thread_count_];
+                std::copy(prev, prev + thread_count_, scratch_.begin());
+            } else {
+                std::fill(scratch_.begin(), scratch_.end(), 0);
+            }
+            for (const std::vector<uint32_t>* preds :
+                 {&base_preds_[idx], &extra_preds_[idx]}) {
+                for (uint32_t pred : *preds) {
+                    const uint32_t* other = &clocks_[pred * thread_count_];
+                    for (size_t i = 0; i < thread_count_; ++i)
+                        scratch_[i] = std::max(scratch_[i], other[i]);
+                }
+            }
+            scratch_[t] = local_idx_[idx];
+            if (std::equal(scratch_.begin(), scratch_.end(), own)) continue;
+
+            std::copy(scratch_.begin(), scratch_.end(), own);
+            if (!is_updated_[idx]) {
+                is_updated_[idx] = 1;
+                updated_.push_back(idx);
+            }
+            if (local_idx_[idx] < thread_events_[t].size())
+                schedule(thread_events_[t][local_idx_[idx]]);
+            for (uint32_t succ : base_succs_[idx]) schedule(succ);
+            for (uint32_t succ : extra_succs_[idx]) schedule(succ);
+        }
+    }
+
+    /* false when the edge is already known or would point backwards */
+    bool addEdge(uint32_t from, uint32_t to) {
+        if (from >= to || before(from, to)) return false;
+        touched_.push_back(from);
+        touched_.push_back(to);
+        extra_preds_[to].push_back(from);
+        extra_succs_[from].push_back(to);
+        schedule(to);
+        stats_.derived_edges++;
+        return true;
+    }
+
+    bool applyLockRule(std::vector<std::vector<uint32_t>>& preds,
+                       bool base) {
+        bool changed = false;
+        for (const auto& [acq1, acq2] : lock_pairs_) {
+            uint32_t rel1 = release_of_[acq1], rel2 = release_of_[acq2];
+            if (rel1 == kNone || rel2 == kNone) continue;
+
+            for (const auto& [a, ra, b, rb] :
+                 {std::make_tuple(acq1, rel1, acq2, rel2),
+                  std::make_tuple(acq2, rel2, acq1, rel1)}) {
+                if (!before(a, rb) || before(ra, b) || ra >= b) continue;
+                if (base) {
+                    preds[b].push_back(ra);
+                    stats_.derived_edges++;
+                    changed = true;
+                } else {
+                    changed |= addEdge(ra, b);
+                }
+            }
+        }
+        return changed;
+    }
+
+    const ReadWrites& writesOf(uint32_t read) {
+        ReadWrites& rw = read_writes_[read];
+        if (rw.ready) return rw;
+
+        const Event& e = events_[read];
+        for (const Event& w : trace_.getGoodWritesForRead(e))
+            rw.good.push_back(w.getEventId() - 1);
+        for (const Event& w : trace_.getBadWritesForRead(e))
+            rw.bad.push_back(w.getEventId() - 1);
+        rw.initial = trace_.hasSameInitialValue(e);
+        rw.ready = true;
+        return rw;
+    }
+
+    /* false if a required read has nothing left to read from */
+    bool applyReadRule(bool& changed) {
+        for (uint32_t t = 0; t < thread_count_; ++t) {
+            for (uint32_t i = 0; i < required_[t]; ++i) {
+                uint32_t read = thread_events_[t][i];
+                if (events_[read].getEventType() != Event::EventType::Read)
+                    continue;
+
+                const ReadWrites& rw = writesOf(read);
+
+                uint32_t source = kNone, alive = 0;
+                for (uint32_t w : rw.good) {
+                    if (w == read || before(read, w)) continue;
+                    source = w;
+                    if (++alive > 1) break;
+                }
+
+                bool initial = rw.initial;
+                for (uint32_t w : rw.good)
+                    initial = initial && !before(w, read);
+                for (uint32_t w : rw.bad)
+                    initial = initial && !before(w, read);
+                if (initial) alive++;
+
+                if (alive == 0) return false;
+                if (alive > 1) continue;
+
+                if (initial) {
+                    for (uint32_t w : rw.good) changed |= addEdge(read, w);
+                    for (uint32_t w : rw.bad) changed |= addEdge(read, w);
+                    continue;
+                }
+
+                changed |= addEdge(source, read);
+                uint32_t st = thread_of_[source];
+                if (local_idx_[source] - 1 > required_[st]) {
+                    required_[st] = local_idx_[source] - 1;
+                    changed = true;
+                }
+
+                for (uint32_t bad : rw.bad) {
+                    if (before(bad, read)) changed |= addEdge(bad, source);
+                    if (before(source, bad)) changed |= addEdge(read, bad);
+                }
+            }
+        }
+        return true;
+    }
+
+   public:
+    SaturationEngine(
+        const Trace& trace,
+        const std::vector<std::pair<Event, Event>>& mhbEdges,
+        const std::vector<std::pair<LockRegion, LockRegion>>& lockPairs)
+        : events_(trace.getAllEvents()), trace_(trace) {
+        size_t n = events_.size();
+        std::unordered_map<uint32_t, uint32_t> tid_to_idx;
+        thread_of_.resize(n);
+        local_idx_.resize(n);
+        for (uint32_t idx = 0; idx < n; ++idx) {
+            auto [it, added] = tid_to_idx.try_emplace(
+                events_[idx].getThreadId(),
+                static_cast<uint32_t>(thread_events_.size()));
+            if (added) thread_events_.emplace_back();
+            thread_of_[idx] = it->second;
+            thread_events_[it->second].push_back(idx);
+            local_idx_[idx] =
+                static_cast<uint32_t>(thread_events_[it->second].size());
+        }
+        thread_count_ = thread_events_.size();
+
+        base_preds_.resize(n);
+        for (const auto& [from, to] : mhbEdges) {
+            if (Event::isNullEvent(from) || Event::isNullEvent(to)) continue;
+            base_preds_[to.getEventId() - 1].push_back(from.getEventId() - 1);
+        }
+
+        release_of_.assign(n, kNone);
+        for (const auto& [lr1, lr2] : lockPairs) {
+            for (const LockRegion* lr : {&lr1, &lr2}) {
+                if (!Event::isNullEvent(lr->getRelEvent()))
+                    release_of_[lr->getAcqEvent().getEventId() - 1] =
+                        lr->getRelEvent().getEventId() - 1;
+            }
+            lock_pairs_.emplace_back(lr1.getAcqEvent().getEventId() - 1,
+                                     lr2.getAcqEvent().getEventId() - 1);
+        }
+
+        read_writes_.resize(n);
+        extra_preds_.resize(n);
+        extra_succs_.resize(n);
+        clocks_.assign(n * thread_count_, 0);
+        queued_.assign(n, 0);
+        is_updated_.assign(n, 0);
+        scratch_.assign(thread_count_, 0);
+
+        /* the lock rule alone does not depend on the COP */
+        do {
+            computeClocks();
+        } while (applyLockRule(base_preds_, true));
+        base_clocks_ = clocks_;
+
+        base_succs_.resize(n);
+        for (uint32_t idx = 0; idx < n; ++idx)
+            for (uint32_t pred : base_preds_[idx])
+                base_succs_[pred].push_back(idx);
+    }
+
+    /* true if no schedule puts e1 and e2 next to each other */
+    bool refutes(const Event& e1, const Event& e2) {
+        stats_.cops++;
+        for (uint32_t idx : touched_) {
+            extra_preds_[idx].clear();
+            extra_succs_[idx].clear();
+        }
+        touched_.clear();
+        for (; !pending_.empty(); pending_.pop()) queued_[pending_.top()] = 0;
+        for (uint32_t idx : updated_) {
+            std::copy(&base_clocks_[idx * thread_count_],
+                      &base_clocks_[(idx + 1) * thread_count_],
+                      &clocks_[idx * thread_count_]);
+            is_updated_[idx] = 0;
+        }
+        updated_.clear();
+
+        uint32_t i1 = e1.getEventId() - 1, i2 = e2.getEventId() - 1;
+        required_.assign(thread_count_, 0);
+        required_[thread_of_[i1]] = local_idx_[i1] - 1;
+        required_[thread_of_[i2]] = local_idx_[i2] - 1;
+
+        bool refuted = false;
+        while (true) {
+            stats_.rounds++;
+            propagate();
+            if (before(i1, i2) || before(i2, i1)) {
+                refuted = true;
+                break;
+            }
+
+            bool changed = false;
+            if (!applyReadRule(changed)) {
+                refuted = true;
+                break;
+            }
+            changed |= applyLockRule(extra_preds_, false);
+            if (!changed) break;
+        }
+
+        if (refuted) stats_.refuted++;
+        return refuted;
+    }
+
+    const Stats& getStats() const { return stats_; }
+};
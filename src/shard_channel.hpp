@@ -0,0 +1,87 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <vector>
+
+/**
+ * ShardChannel frames the messages between the coordinator and a forked
+ * solver process over a pair of pipes. The coordinator hands out shards as
+ * [begin, end) ranges of COP indices, an empty range stops the worker. The
+ * worker reports every COP it checked, with the witness of a race, and asks
+ * for the next shard once it is done with the current one.
+ */
+namespace ShardChannel {
+
+enum MessageType : uint8_t { Ready = 1, Result = 2 };
+
+struct Message {
+    MessageType type = Ready;
+    uint32_t cop = 0;
+    bool sat = false;
+    std::vector<uint32_t> witness;
+};
+
+inline bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/* false on end of file or error, i.e. when the other side is gone */
+inline bool readAll(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = ::read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+inline bool sendShard(int fd, uint64_t begin, uint64_t end) {
+    uint64_t range[2] = {begin, end};
+    return writeAll(fd, range, sizeof(range));
+}
+
+inline bool receiveShard(int fd, uint64_t& begin, uint64_t& end) {
+    uint64_t range[2];
+    if (!readAll(fd, range, sizeof(range))) return false;
+    begin = range[0];
+    end = range[1];
+    return true;
+}
+
+inline bool sendMessage(int fd, const Message& message) {
+    uint32_t header[3] = {message.type, message.cop, message.sat ? 1u : 0u};
+    uint32_t size = static_cast<uint32_t>(message.witness.size());
+    return writeAll(fd, header, sizeof(header)) &&
+           writeAll(fd, &size, sizeof(size)) &&
+           writeAll(fd, message.witness.data(), size * sizeof(uint32_t));
+}
+
+inline bool receiveMessage(int fd, Message& message) {
+    uint32_t header[3];
+    uint32_t size;
+    if (!readAll(fd, header, sizeof(header)) ||
+        !readAll(fd, &size, sizeof(size)))
+        return false;
+
+    message.type = static_cast<MessageType>(header[0]);
+    message.cop = header[1];
+    message.sat = header[2] != 0;
+    message.witness.resize(size);
+    return readAll(fd, message.witness.data(), size * sizeof(uint32_t));
+}
+
+}  // namespace ShardChannel
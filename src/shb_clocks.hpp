@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "event.hpp"
+#include "trace.hpp"
+
+/**
+ * SHBClocks assigns a vector clock to every event for the schedulable
+ * happens before order: the must happen before edges, every release to the
+ * later acquires of its lock, and the last write of a variable to each read
+ * that follows it. Two conflicting events e1 < e2 where e1 is not ordered
+ * before the program order predecessor of e2 are a race, and the events
+ * ordered before either predecessor, in trace order, are a correct
+ * reordering that ends right before them.
+ */
+class SHBClocks {
+   private:
+    size_t thread_count_ = 0;
+    std::vector<uint32_t> tid_to_idx_;
+    std::vector<uint32_t> clocks_;  // event idx * thread_count_ + thread idx
+    std::vector<std::vector<EID>> thread_events_;  // by thread idx
+    std::vector<Event> events_;
+
+    static constexpr uint32_t kMaxThreads = 256;
+
+    inline const uint32_t* clockOf(EID eid) const {
+        return &clocks_[(eid - 1) * thread_count_];
+    }
+
+    inline uint32_t localIdx(const Event& e) const {
+        return clockOf(e.getEventId())[tid_to_idx_[e.getThreadId()]];
+    }
+
+    /* clock of the event before e in its thread, null for the first one */
+    inline const uint32_t* predClockOf(const Event& e) const {
+        uint32_t idx = localIdx(e);
+        if (idx <= 1) return nullptr;
+        return clockOf(thread_events_[tid_to_idx_[e.getThreadId()]][idx - 2]);
+    }
+
+   public:
+    explicit SHBClocks(const Trace& trace)
+        : tid_to_idx_(kMaxThreads, 0), events_(trace.getAllEvents()) {
+        for (const Thread& thread : trace.getThreads())
+            tid_to_idx_[thread.getThreadId()] =
+                static_cast<uint32_t>(thread_count_++);
+        thread_events_.resize(thread_count_);
+
+        std::unordered_map<EID, EID> begin_to_fork;
+        for (const auto& [forkEvent, beginEvent] : trace.getForkBeginPairs())
+            begin_to_fork[beginEvent.getEventId()] = forkEvent.getEventId();
+
+        std::unordered_map<EID, EID> join_to_end;
+        for (const auto& [endEvent, joinEvent] : trace.getEndJoinPairs())
+            join_to_end[joinEvent.getEventId()] = endEvent.getEventId();
+
+        clocks_.assign(events_.size() * thread_count_, 0);
+
+        std::vector<std::vector<uint32_t>> thread_clocks(
+            thread_count_, std::vector<uint32_t>(thread_count_, 0));
+        std::unordered_map<uint32_t, EID> last_release;  // by lock
+        std::unordered_map<uint32_t, EID> last_write;    // by variable
+
+        for (const Event& e : events_) {
+            uint32_t t = tid_to_idx_[e.getThreadId()];
+            std::vector<uint32_t>& clock = thread_clocks[t];
+
+            EID pred = 0;
+            switch (e.getEventType()) {
+                case Event::EventType::Begin: {
+                    auto it = begin_to_fork.find(e.getEventId());
+                    if (it != begin_to_fork.end()) pred = it->second;
+                    break;
+                }
+                case Event::EventType::Join: {
+                    auto it = join_to_end.find(e.getEventId());
+                    if (it != join_to_end.end()) pred = it->second;
+                    break;
+                }
+                case Event::EventType::Acquire: {
+                    auto it = last_release.find(e.getTargetId());
+                    if (it != last_release.end()) pred = it->second;
+                    break;
+                }
+                case Event::EventType::Read: {
+                    auto it = last_write.find(e.getTargetId());
+                    if (it != last_write.end()) pred = it->second;
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            if (pred != 0) {
+                const uint32_t* other = clockOf(pred);
+                for (size_t i = 0; i < thread_count_; ++i)
+                    clock[i] = std::max(clock[i], other[i]);
+            }
+
+            clock[t]++;
+            std::copy(clock.begin(), clock.end(),
+                      clocks_.begin() + (e.getEventId() - 1) * thread_count_);
+            thread_events_[t].push_back(e.getEventId());
+
+            if (e.getEventType() == Event::EventType::Release)
+                last_release[e.getTargetId()] = e.getEventId();
+            else if (e.getEventType() == Event::EventType::Write)
+                last_write[e.getTargetId()] = e.getEventId();
+        }
+    }
+
+    /* e1 and e2 are conflicting accesses of different threads */
+    bool isRace(const Event& e1, const Event& e2) const {
+        const Event& first = e1.getEventId() < e2.getEventId() ? e1 : e2;
+        const Event& second = e1.getEventId() < e2.getEventId() ? e2 : e1;
+
+        const uint32_t* pred = predClockOf(second);
+        return pred == nullptr ||
+               pred[tid_to_idx_[first.getThreadId()]] < localIdx(first);
+    }
+
+    /* events ordered before the predecessor of e1 or of e2, in trace
+     * order, followed by the race itself */
+    std::vector<uint32_t> witness(const Event& e1, const Event& e2) const {
+        std::vector<uint32_t> bound(thread_count_, 0);
+        for (const Event* e : {&e1, &e2}) {
+            const uint32_t* pred = predClockOf(*e);
+            if (pred == nullptr) continue;
+            for (size_t i = 0; i < thread_count_; ++i)
+                bound[i] = std::max(bound[i], pred[i]);
+        }
+
+        std::vector<uint32_t> witness;
+        for (const Event& e : events_) {
+            if (localIdx(e) <= bound[tid_to_idx_[e.getThreadId()]])
+                witness.push_back(e.getEventId());
+        }
+
+        bool inOrder = e1.getEventId() < e2.getEventId();
+        witness.push_back(inOrder ? e1.getEventId() : e2.getEventId());
+        witness.push_back(inOrder ? e2.getEventId() : e1.getEventId());
+        return witness;
+    }
+};
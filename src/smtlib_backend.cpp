@@ -0,0 +1,285 @@
+#include "smtlib_backend.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "BSlogger.hpp"
+#include "z3_term_cache.hpp"
+
+struct SmtLibBackend::SExpr {
+    std::string atom;
+    std::vector<SExpr> list;
+    bool is_list = false;
+
+    bool isError() const {
+        return is_list && !list.empty() && list[0].atom == "error";
+    }
+};
+
+namespace {
+
+void skipSpace(const std::string& text, size_t& pos) {
+    while (pos < text.size()) {
+        if (std::isspace(static_cast<unsigned char>(text[pos]))) {
+            pos++;
+        } else if (text[pos] == ';') {
+            while (pos < text.size() && text[pos] != '\n') pos++;
+        } else {
+            break;
+        }
+    }
+}
+
+}  // namespace
+
+SmtLibBackend::SExpr SmtLibBackend::parseSExpr(const std::string& text,
+                                               size_t& pos) {
+    SExpr e;
+    if (text[pos] == '(') {
+        pos++;
+        e.is_list = true;
+        while (skipSpace(text, pos), pos < text.size()) {
+            if (text[pos] == ')') {
+                pos++;
+                break;
+            }
+            e.list.push_back(parseSExpr(text, pos));
+        }
+        return e;
+    }
+
+    size_t start = pos;
+    if (text[pos] == '"' || text[pos] == '|') {
+        char quote = text[pos++];
+        while (pos < text.size() && text[pos] != quote) pos++;
+        pos = std::min(pos + 1, text.size());
+    } else {
+        while (pos < text.size() && text[pos] != '(' && text[pos] != ')' &&
+               !std::isspace(static_cast<unsigned char>(text[pos])))
+            pos++;
+    }
+    /* a stray closing parenthesis is skipped as an empty atom */
+    if (pos == start) pos++;
+    e.atom = text.substr(start, pos - start);
+    return e;
+}
+
+SmtLibBackend::SmtLibBackend(z3::context& c, const std::string& command,
+                             size_t batchSize, const std::string& dir)
+    : c_(c),
+      command_(command),
+      dir_(dir.empty() ? std::filesystem::temp_directory_path().string()
+                       : dir),
+      batch_size_(batchSize ? batchSize : 1),
+      asserted_exprs_(c) {
+    std::filesystem::create_directories(dir_);
+}
+
+const std::string& SmtLibBackend::declare(const z3::expr& e) {
+    auto it = names_.find(e.id());
+    if (it != names_.end()) return it->second;
+
+    /* event variables get readable names, the rest keep their own */
+    std::string name;
+    EID eid;
+    Z3TermCache::Kind kind;
+    bool event = Z3TermCache::decode(e.decl(), eid, kind);
+    if (event)
+        name = (kind == Z3TermCache::Kind::Order ? "o" : "p") +
+               std::to_string(eid);
+    else
+        name = "|" + e.decl().name().str() + "|";
+
+    declarations_ << "(declare-fun " << name << " () "
+                  << (e.is_bool() ? "Bool" : "Int") << ")\n";
+    consts_.emplace(name, e);
+    if (event) event_consts_.push_back(name);
+    return names_.emplace(e.id(), name).first->second;
+}
+
+void SmtLibBackend::print(std::ostream& out, const z3::expr& e) {
+    int64_t numeral;
+    if (e.is_true()) {
+        out << "true";
+    } else if (e.is_false()) {
+        out << "false";
+    } else if (e.is_numeral_i64(numeral)) {
+        if (numeral < 0)
+            out << "(- " << -numeral << ")";
+        else
+            out << numeral;
+    } else if (e.is_const()) {
+        out << declare(e);
+    } else if (e.is_app()) {
+        /* the builtin operators of the encoding carry their SMT-LIB names */
+        out << "(" << e.decl().name().str();
+        for (unsigned i = 0; i < e.num_args(); ++i) {
+            out << " ";
+            print(out, e.arg(i));
+        }
+        out << ")";
+    } else {
+        throw std::runtime_error("Unsupported term: " + e.to_string());
+    }
+}
+
+void SmtLibBackend::add(const z3::expr& e) {
+    if (!asserted_.insert(e.id()).second) {
+        stats_.duplicate_assertions++;
+        return;
+    }
+    asserted_exprs_.push_back(e);
+    stats_.base_assertions++;
+
+    base_ << "(assert ";
+    print(base_, e);
+    base_ << ")\n";
+}
+
+SolverBackend::Answer SmtLibBackend::check(
+    const z3::expr_vector& assumptions) {
+    return checkBatch({assumptions})[0];
+}
+
+z3::model SmtLibBackend::parseModel(const SExpr& values) {
+    z3::model m(c_);
+    for (const SExpr& pair : values.list) {
+        if (!pair.is_list || pair.list.size() != 2) continue;
+
+        auto it = consts_.find(pair.list[0].atom);
+        if (it == consts_.end()) continue;
+
+        const SExpr& v = pair.list[1];
+        z3::expr value(c_);
+        if (v.atom == "true" || v.atom == "false") {
+            value = c_.bool_val(v.atom == "true");
+        } else if (!v.is_list) {
+            value = c_.int_val(static_cast<int64_t>(std::stoll(v.atom)));
+        } else if (v.list.size() == 2 && v.list[0].atom == "-") {
+            value = c_.int_val(-static_cast<int64_t>(std::stoll(v.list[1].atom)));
+        } else {
+            continue;
+        }
+
+        z3::func_decl decl = it->second.decl();
+        m.add_const_interp(decl, value);
+    }
+    return m;
+}
+
+std::vector<SolverBackend::Answer> SmtLibBackend::checkBatch(
+    const std::vector<z3::expr_vector>& queries) {
+    LOG_INIT_COUT();
+
+    /* the queries first, they may declare variables of their own. Each
+     * assumption is defined by a fresh constant a<query>_<idx> instead of
+     * a push/pop scope, which keeps the solver's state across the checks */
+    std::ostringstream body;
+    for (size_t q = 0; q < queries.size(); ++q) {
+        const z3::expr_vector& assumptions = queries[q];
+        for (unsigned i = 0; i < assumptions.size(); ++i) {
+            body << "(declare-fun a" << q << "_" << i << " () Bool)\n"
+                 << "(assert (= a" << q << "_" << i << " ";
+            print(body, assumptions[i]);
+            body << "))\n";
+        }
+        body << "(check-sat-assuming (";
+        for (unsigned i = 0; i < assumptions.size(); ++i)
+            body << (i ? " a" : "a") << q << "_" << i;
+        body << "))\n(get-value (";
+        for (const std::string& name : event_consts_) body << " " << name;
+        body << "))\n(get-unsat-core)\n";
+    }
+
+    std::string path = dir_ + "/predictor_" + std::to_string(getpid()) +
+                       "_" + std::to_string(stats_.files++) + ".smt2";
+    {
+        std::ofstream file(path);
+        if (!file.is_open())
+            throw std::runtime_error("Failed to open SMT-LIB file " + path);
+        file << "(set-option :produce-models true)\n"
+             << "(set-option :produce-unsat-cores true)\n"
+             << "(set-logic QF_IDL)\n"
+             << declarations_.str() << base_.str() << body.str();
+    }
+
+    std::string output;
+    FILE* pipe = popen((command_ + " " + path).c_str(), "r");
+    if (!pipe) throw std::runtime_error("Failed to run " + command_);
+    char buffer[1 << 16];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+        output.append(buffer, n);
+    pclose(pipe);
+    std::filesystem::remove(path);
+
+    /* each check answers a status, the values and the core */
+    std::vector<SExpr> responses;
+    size_t pos = 0;
+    while (skipSpace(output, pos), pos < output.size())
+        responses.push_back(parseSExpr(output, pos));
+
+    std::vector<Answer> answers(queries.size());
+    size_t next = 0;
+    for (size_t q = 0; q < queries.size(); ++q) {
+        Answer& answer = answers[q];
+        stats_.checks++;
+
+        /* status, then whatever get-value and get-unsat-core answered */
+        auto isStatus = [](const SExpr& e) {
+            return !e.is_list && (e.atom == "sat" || e.atom == "unsat" ||
+                                  e.atom == "unknown");
+        };
+        while (next < responses.size() && !isStatus(responses[next])) next++;
+        if (next >= responses.size()) {
+            stats_.unknown++;
+            continue;
+        }
+
+        const std::string& status = responses[next++].atom;
+        const SExpr* values = next < responses.size() ? &responses[next] : nullptr;
+        const SExpr* core =
+            next + 1 < responses.size() ? &responses[next + 1] : nullptr;
+
+        if (status == "sat") {
+            stats_.sat++;
+            answer.result = Result::Sat;
+            if (values && values->is_list && !values->isError())
+                answer.model = parseModel(*values);
+        } else if (status == "unsat") {
+            stats_.unsat++;
+            answer.result = Result::Unsat;
+            if (core && core->is_list && !core->isError()) {
+                for (const SExpr& name : core->list) {
+                    size_t sep = name.atom.find('_');
+                    if (name.atom[0] == 'a' && sep != std::string::npos)
+                        answer.core.push_back(
+                            std::stoul(name.atom.substr(sep + 1)));
+                }
+            }
+        } else {
+            stats_.unknown++;
+        }
+    }
+
+    if (responses.empty())
+        log(LOG_ERROR) << "No answer from " << command_ << "\n";
+
+    return answers;
+}
+
+void SmtLibBackend::logStats() const {
+    LOG_INIT_COUT();
+    log(LOG_INFO) << "SMT-LIB backend: " << stats_.files << " files, "
+                  << stats_.checks << " checks (" << stats_.sat << " sat, "
+                  << stats_.unsat << " unsat, " << stats_.unknown
+                  << " unknown), " << stats_.base_assertions
+                  << " base assertions written once per file, "
+                  << stats_.duplicate_assertions << " duplicates dropped\n";
+}
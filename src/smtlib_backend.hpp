@@ -0,0 +1,74 @@
+#pragma once
+
+#include <z3++.h>
+
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "solver_backend.hpp"
+
+/**
+ * SmtLibBackend hands the checks to an external solver binary. Each batch
+ * of checks becomes one SMT-LIB2 file: the declarations and the base
+ * assertions, written once, followed per check by check-sat-assuming,
+ * get-value over the event variables and get-unsat-core. The file is passed
+ * as the last argument of the configured command (e.g. "z3 -smt2") and the
+ * answers are read back from its output.
+ * The solver is expected to carry on after the error a get-value on an
+ * unsat check or a get-unsat-core on a sat one reports, as z3 does.
+ */
+class SmtLibBackend : public SolverBackend {
+   public:
+    struct Stats {
+        uint64_t files = 0;
+        uint64_t checks = 0;
+        uint64_t sat = 0;
+        uint64_t unsat = 0;
+        uint64_t unknown = 0;
+        uint64_t base_assertions = 0;
+        uint64_t duplicate_assertions = 0;
+    };
+
+   private:
+    z3::context& c_;
+    std::string command_;
+    std::string dir_;
+    size_t batch_size_;
+
+    std::ostringstream declarations_;
+    std::ostringstream base_;
+    z3::expr_vector asserted_exprs_;  // keeps the AST ids below in use
+    std::unordered_set<unsigned> asserted_;  // AST ids of base assertions
+    std::unordered_map<unsigned, std::string> names_;  // by const AST id
+    std::unordered_map<std::string, z3::expr> consts_;
+    std::vector<std::string> event_consts_;  // reported by get-value
+
+    Stats stats_;
+
+    /* a parsed response, an atom or a list */
+    struct SExpr;
+
+    const std::string& declare(const z3::expr& e);
+    void print(std::ostream& out, const z3::expr& e);
+
+    static SExpr parseSExpr(const std::string& text, size_t& pos);
+    z3::model parseModel(const SExpr& values);
+
+   public:
+    SmtLibBackend(z3::context& c, const std::string& command,
+                  size_t batchSize, const std::string& dir);
+
+    void add(const z3::expr& e) override;
+    Answer check(const z3::expr_vector& assumptions) override;
+    std::vector<Answer> checkBatch(
+        const std::vector<z3::expr_vector>& queries) override;
+
+    size_t getBatchSize() const override { return batch_size_; }
+
+    void logStats() const override;
+};
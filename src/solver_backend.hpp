@@ -0,0 +1,142 @@
+#pragma once
+
+#include <z3++.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "BSlogger.hpp"
+#include "check_watchdog.hpp"
+
+/**
+ * SolverBackend is what CasualModel checks its COPs with. The constraints
+ * shared by all COPs are added once, then each COP is a check under the
+ * halves of its race query as assumptions. A sat answer carries a model over
+ * the event variables, an unsat one the assumptions it needed. Backends that
+ * are expensive to start answer a block of checks at once in checkBatch and
+ * say how large a block should be; the others answer one at a time.
+ */
+class SolverBackend {
+   public:
+    enum class Result { Sat, Unsat, Unknown };
+
+    struct Answer {
+        Result result = Result::Unknown;
+        std::optional<z3::model> model;
+        std::vector<size_t> core;  // idxs into the assumptions
+    };
+
+    virtual ~SolverBackend() = default;
+
+    virtual void add(const z3::expr& e) = 0;
+
+    void add(const z3::expr_vector& formulas) {
+        for (const z3::expr& e : formulas) add(e);
+    }
+
+    virtual Answer check(const z3::expr_vector& assumptions) = 0;
+
+    virtual std::vector<Answer> checkBatch(
+        const std::vector<z3::expr_vector>& queries) {
+        std::vector<Answer> answers;
+        for (const z3::expr_vector& assumptions : queries)
+            answers.push_back(check(assumptions));
+        return answers;
+    }
+
+    /* number of checks worth handing to checkBatch at once */
+    virtual size_t getBatchSize() const { return 1; }
+
+    /* limit on each following check, after which it answers unknown; 0
+     * lifts it. Backends that cannot stop a check ignore it */
+    virtual void setTimeout(unsigned /*ms*/) {}
+
+    /* drops everything added so far and starts over from base; false if
+     * the backend cannot, in which case it keeps what it holds */
+    virtual bool reset(const z3::expr_vector& /*base*/) { return false; }
+
+    virtual void logStats() const {}
+};
+
+/**
+ * Z3Backend checks on a z3::solver owned by the caller, so the constraints
+ * already asserted on it are the base of the backend. Checks under a timeout
+ * are cut short by a CheckWatchdog; what was added since the last check is
+ * taken in by one untimed check first, as a stop while it is still being
+ * taken in leaves the solver answering sat to checks it should refute.
+ */
+class Z3Backend : public SolverBackend {
+   private:
+    z3::solver& s_;
+    unsigned timeout_ = 0;
+    std::unique_ptr<CheckWatchdog> watchdog_;
+    bool warm_ = false;  // what was added went through an untimed check
+    uint64_t timeouts_ = 0;
+
+   public:
+    explicit Z3Backend(z3::solver& s) : s_(s) {}
+
+    void add(const z3::expr& e) override {
+        s_.add(e);
+        warm_ = false;
+    }
+
+    bool reset(const z3::expr_vector& base) override {
+        s_.reset();
+        s_.add(base);
+        warm_ = false;
+        return true;
+    }
+
+    void setTimeout(unsigned ms) override {
+        timeout_ = ms;
+        if (ms && !watchdog_)
+            watchdog_ = std::make_unique<CheckWatchdog>(s_.ctx());
+    }
+
+    Answer check(const z3::expr_vector& assumptions) override {
+        Answer answer;
+        z3::check_result result;
+        if (timeout_) {
+            /* taking in new constraints is not charged to the COP */
+            if (!warm_) s_.check();
+            warm_ = true;
+            watchdog_->arm(timeout_);
+            result = s_.check(assumptions);
+            if (watchdog_->disarm()) {
+                timeouts_++;
+                return answer;
+            }
+        } else {
+            result = s_.check(assumptions);
+        }
+
+        switch (result) {
+            case z3::sat:
+                answer.result = Result::Sat;
+                answer.model = s_.get_model();
+                break;
+            case z3::unsat:
+                answer.result = Result::Unsat;
+                for (const z3::expr& lit : s_.unsat_core()) {
+                    for (unsigned i = 0; i < assumptions.size(); ++i)
+                        if (z3::eq(lit, assumptions[i]))
+                            answer.core.push_back(i);
+                }
+                break;
+            default:
+                break;
+        }
+        return answer;
+    }
+
+    void logStats() const override {
+        if (!timeouts_) return;
+        LOG_INIT_COUT();
+        log(LOG_INFO) << "Z3 checks cut short by their timeout: " << timeouts_
+                      << "\n";
+    }
+};
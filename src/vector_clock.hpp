@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "event.hpp"
+#include "trace.hpp"
+
+/**
+ * MHBClocks assigns a vector clock to every event of the trace for the must
+ * happen before order: program order together with the fork-begin and
+ * end-join edges. Thread ids are mapped to dense clock indices and the clock
+ * entry of an event for its own thread is its 1-based position in the thread.
+ */
+class MHBClocks {
+   private:
+    size_t thread_count_;
+    std::vector<uint32_t> tid_to_idx_;  // thread ids are 8 bits wide
+    std::vector<uint32_t> clocks_;  // event idx * thread_count_ + thread idx
+
+    static constexpr uint32_t kMaxThreads = 256;
+
+    inline const uint32_t* clockOf(const Event& e) const {
+        return &clocks_[(e.getEventId() - 1) * thread_count_];
+    }
+
+   public:
+    MHBClocks() : thread_count_(0), tid_to_idx_(kMaxThreads, 0) {}
+
+    MHBClocks(const Trace& trace) : MHBClocks() {
+        for (const Thread& thread : trace.getThreads())
+            tid_to_idx_[thread.getThreadId()] =
+                static_cast<uint32_t>(thread_count_++);
+
+        std::unordered_map<EID, Event> begin_to_fork;
+        for (const auto& [forkEvent, beginEvent] : trace.getForkBeginPairs())
+            begin_to_fork[beginEvent.getEventId()] = forkEvent;
+
+        std::unordered_map<EID, Event> join_to_end;
+        for (const auto& [endEvent, joinEvent] : trace.getEndJoinPairs())
+            join_to_end[joinEvent.getEventId()] = endEvent;
+
+        std::vector<Event> events = trace.getAllEvents();
+        clocks_.assign(events.size() * thread_count_, 0);
+
+        std::vector<std::vector<uint32_t>> thread_clocks(
+            thread_count_, std::vector<uint32_t>(thread_count_, 0));
+
+        for (const Event& e : events) {
+            uint32_t t = tid_to_idx_[e.getThreadId()];
+            std::vector<uint32_t>& clock = thread_clocks[t];
+
+            const Event* pred = nullptr;
+            if (e.getEventType() == Event::EventType::Begin) {
+                auto it = begin_to_fork.find(e.getEventId());
+                if (it != begin_to_fork.end()) pred = &it->second;
+            } else if (e.getEventType() == Event::EventType::Join) {
+                auto it = join_to_end.find(e.getEventId());
+                if (it != join_to_end.end()) pred = &it->second;
+            }
+
+            if (pred != nullptr && !Event::isNullEvent(*pred)) {
+                const uint32_t* other = clockOf(*pred);
+                for (size_t i = 0; i < thread_count_; ++i)
+                    clock[i] = std::max(clock[i], other[i]);
+            }
+
+            clock[t]++;
+            std::copy(clock.begin(), clock.end(),
+                      clocks_.begin() + (e.getEventId() - 1) * thread_count_);
+        }
+    }
+
+    size_t getThreadCount() const { return thread_count_; }
+
+    uint32_t getThreadIdx(TID tid) const { return tid_to_idx_[tid]; }
+
+    /* 1-based position of the event in its thread */
+    uint32_t getLocalIdx(const Event& e) const {
+        return clockOf(e)[tid_to_idx_[e.getThreadId()]];
+    }
+
+    /* number of events of the thread that happen before or at e */
+    uint32_t getClock(const Event& e, TID tid) const {
+        return clockOf(e)[tid_to_idx_[tid]];
+    }
+
+    /* pointwise max of the clock of e into a clock indexed by thread idx */
+    void joinInto(const Event& e, std::vector<uint32_t>& clock) const {
+        const uint32_t* other = clockOf(e);
+        for (size_t i = 0; i < thread_count_; ++i)
+            clock[i] = std::max(clock[i], other[i]);
+    }
+
+    bool happensBefore(const Event& e1, const Event& e2) const {
+        if (e1.getEventId() == e2.getEventId()) return false;
+        return getLocalIdx(e1) <= getClock(e2, e1.getThreadId());
+    }
+};
@@ -0,0 +1,197 @@
+#include "window_analyzer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "BSlogger.hpp"
+
+WindowAnalyzer::WindowAnalyzer(Trace& trace, ModelLogger& logger,
+                               const ModelOptions& modelOptions,
+                               const WindowOptions& options)
+    : trace_(trace),
+      logger_(logger),
+      model_options_(modelOptions),
+      options_(options),
+      events_(trace.getAllEvents()) {
+    if (options_.window_size == 0 || options_.overlap >= options_.window_size)
+        throw std::runtime_error("Window overlap must be below the window size");
+
+    /* witnesses of a window would refer to its own event ids */
+    model_options_.log_witness = false;
+
+    std::vector<bool> used(256, false);
+    for (const Thread& thread : trace_.getThreads())
+        used[thread.getThreadId()] = true;
+
+    auto it = std::find(used.begin(), used.end(), false);
+    if (it == used.end())
+        throw std::runtime_error("No thread id left for the window seed thread");
+    seed_tid_ = static_cast<TID>(it - used.begin());
+}
+
+void WindowAnalyzer::apply(const Event& e) {
+    ScanState& s = scan_;
+    s.started.insert(e.getThreadId());
+
+    switch (e.getEventType()) {
+        case Event::EventType::Write:
+            s.var_values[e.getTargetId()] = e.getTargetValue();
+            break;
+        case Event::EventType::Acquire:
+            s.held_locks[e.getThreadId()].push_back(e.getTargetId());
+            break;
+        case Event::EventType::Release: {
+            std::vector<uint32_t>& held = s.held_locks[e.getThreadId()];
+            auto lock = std::find(held.rbegin(), held.rend(), e.getTargetId());
+            if (lock != held.rend()) held.erase(std::next(lock).base());
+            break;
+        }
+        case Event::EventType::Fork:
+            s.forked.insert(e.getTargetId());
+            break;
+        case Event::EventType::End:
+            s.ended.insert(e.getThreadId());
+            break;
+        default:
+            break;
+    }
+}
+
+bool WindowAnalyzer::nextWindow(Window& window) {
+    std::lock_guard<std::mutex> guard(scan_mutex_);
+
+    if (stop_ || next_start_ >= events_.size()) return false;
+
+    size_t start = next_start_;
+    size_t end = std::min(start + options_.window_size, events_.size());
+    next_start_ = end == events_.size()
+                      ? events_.size()
+                      : start + options_.window_size - options_.overlap;
+
+    while (scan_.next < start) apply(events_[scan_.next++]);
+
+    window.index = stats_.windows++;
+    window.raw_events.clear();
+    window.to_original.clear();
+
+    auto addSeed = [&window](Event::EventType type, TID tid, uint32_t target,
+                             uint32_t value) {
+        window.raw_events.push_back(
+            Event::createRawEvent(type, tid, target, value));
+        window.to_original.push_back(0);
+    };
+
+    std::vector<TID> threads;
+    std::unordered_set<TID> seen_threads;
+    std::unordered_set<uint32_t> seen_vars;
+    std::vector<TID> joined_ended;
+
+    for (size_t i = start; i < end; ++i) {
+        const Event& e = events_[i];
+        if (seen_threads.insert(e.getThreadId()).second)
+            threads.push_back(e.getThreadId());
+
+        if (e.getEventType() == Event::EventType::Read ||
+            e.getEventType() == Event::EventType::Write) {
+            if (seen_vars.insert(e.getTargetId()).second) {
+                auto value = scan_.var_values.find(e.getTargetId());
+                if (value != scan_.var_values.end())
+                    addSeed(Event::EventType::Write, seed_tid_,
+                            e.getTargetId(), value->second);
+            }
+        } else if (e.getEventType() == Event::EventType::Join &&
+                   scan_.ended.count(e.getTargetId())) {
+            joined_ended.push_back(e.getTargetId());
+        }
+    }
+
+    /* threads already running (or forked) at the window start are forked by
+     * the seed thread; a thread that has started also needs a new begin */
+    std::vector<TID> resumed;
+    for (TID tid : threads) {
+        bool started = scan_.started.count(tid) > 0;
+        if (!started && !scan_.forked.count(tid)) continue;
+
+        addSeed(Event::EventType::Fork, seed_tid_, tid, 0);
+        if (started) resumed.push_back(tid);
+    }
+
+    /* threads joined in the window that ended before it */
+    for (TID tid : joined_ended) {
+        addSeed(Event::EventType::Fork, seed_tid_, tid, 0);
+        addSeed(Event::EventType::Begin, tid, 0, 0);
+        addSeed(Event::EventType::End, tid, 0, 0);
+    }
+
+    for (TID tid : resumed) {
+        addSeed(Event::EventType::Begin, tid, 0, 0);
+        auto held = scan_.held_locks.find(tid);
+        if (held == scan_.held_locks.end()) continue;
+        for (uint32_t lock : held->second)
+            addSeed(Event::EventType::Acquire, tid, lock, 0);
+    }
+
+    for (size_t i = start; i < end; ++i) {
+        window.raw_events.push_back(toRaw(events_[i]));
+        window.to_original.push_back(events_[i].getEventId());
+    }
+
+    return true;
+}
+
+void WindowAnalyzer::solveWindow(const Window& window, uint32_t maxCOPCheck,
+                                 uint32_t maxRaceCheck) {
+    Trace trace = Trace::createTrace(window.raw_events);
+    CasualModel model(trace, logger_, model_options_);
+    model.solve(maxCOPCheck, 0);
+
+    std::lock_guard<std::mutex> guard(result_mutex_);
+    for (const auto& [e1, e2] : model.getRaces()) {
+        EID o1 = window.to_original[e1.getEventId() - 1];
+        EID o2 = window.to_original[e2.getEventId() - 1];
+
+        /* seed writes happen before the whole window, so they never race */
+        if (o1 == 0 || o2 == 0) continue;
+
+        stats_.window_races++;
+        if (!races_.insert({std::min(o1, o2), std::max(o1, o2)}).second)
+            stats_.duplicate_races++;
+    }
+
+    if (maxRaceCheck && races_.size() >= maxRaceCheck) stop_ = true;
+}
+
+uint32_t WindowAnalyzer::solve(uint32_t maxCOPCheck, uint32_t maxRaceCheck) {
+    LOG_INIT_COUT();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    unsigned threadCount = std::max(1u, options_.threads);
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < threadCount; ++w) {
+        workers.emplace_back([this, maxCOPCheck, maxRaceCheck]() {
+            Window window;
+            while (nextWindow(window))
+                solveWindow(window, maxCOPCheck, maxRaceCheck);
+        });
+    }
+
+    for (std::thread& worker : workers) worker.join();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    log(LOG_INFO) << "Windowed analysis: " << stats_.windows << " windows of "
+                  << options_.window_size << " events (overlap "
+                  << options_.overlap << ") on " << threadCount
+                  << " threads, " << races_.size() << " races ("
+                  << stats_.duplicate_races
+                  << " duplicates across overlaps), "
+                  << static_cast<uint64_t>(seconds > 0 ? events_.size() / seconds
+                                                       : 0)
+                  << " events/s\n";
+
+    uint32_t race_count = static_cast<uint32_t>(races_.size());
+    return maxRaceCheck ? std::min(race_count, maxRaceCheck) : race_count;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "casual_model.hpp"
+#include "event.hpp"
+#include "model_logger.hpp"
+#include "trace.hpp"
+
+struct WindowOptions {
+    uint32_t window_size = 0;  // events per window, 0 analyses the whole trace
+    uint32_t overlap = 0;      // events shared by consecutive windows
+    unsigned threads = 1;      // windows solved concurrently
+};
+
+/**
+ * WindowAnalyzer predicts races on fixed size, overlapping windows of the
+ * trace instead of encoding the whole trace at once. Every window becomes a
+ * trace of its own, prefixed by a seed thread that writes the value each
+ * variable holds at the window start and forks the threads running in the
+ * window, which then re-acquire the locks they hold at that point. Windows
+ * are solved concurrently, each by its own CasualModel and Z3 context, and
+ * races are merged by their original event ids.
+ */
+class WindowAnalyzer {
+   public:
+    struct Stats {
+        uint64_t windows = 0;
+        uint64_t window_races = 0;  // races found summed over the windows
+        uint64_t duplicate_races = 0;  // found again in an overlapping window
+    };
+
+   private:
+    /* state of the trace right before the next window */
+    struct ScanState {
+        size_t next = 0;  // first event not applied yet
+        std::unordered_map<uint32_t, uint32_t> var_values;
+        std::unordered_map<TID, std::vector<uint32_t>> held_locks;
+        std::unordered_set<TID> started;  // threads with an applied event
+        std::unordered_set<TID> forked;
+        std::unordered_set<TID> ended;
+    };
+
+    struct Window {
+        size_t index = 0;
+        std::vector<uint64_t> raw_events;
+        std::vector<EID> to_original;  // 0 for synthetic seed events
+    };
+
+    Trace& trace_;
+    ModelLogger& logger_;
+    ModelOptions model_options_;
+    WindowOptions options_;
+
+    std::vector<Event> events_;
+    TID seed_tid_;
+
+    std::mutex scan_mutex_;
+    ScanState scan_;
+    size_t next_start_ = 0;
+
+    std::mutex result_mutex_;
+    std::set<std::pair<EID, EID>> races_;
+    Stats stats_;
+    std::atomic<bool> stop_{false};
+
+    static uint64_t toRaw(const Event& e) {
+        return Event::createRawEvent(e.getEventType(), e.getThreadId(),
+                                     e.getTargetId(), e.getTargetValue());
+    }
+
+    void apply(const Event& e);
+    bool nextWindow(Window& window);
+    void solveWindow(const Window& window, uint32_t maxCOPCheck,
+                     uint32_t maxRaceCheck);
+
+   public:
+    WindowAnalyzer(Trace& trace, ModelLogger& logger,
+                   const ModelOptions& modelOptions,
+                   const WindowOptions& options);
+
+    uint32_t solve(uint32_t maxCOPCheck, uint32_t maxRaceCheck);
+
+    const Stats& getStats() const { return stats_; }
+};
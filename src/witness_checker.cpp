@@ -0,0 +1,105 @@
+#include "witness_checker.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "BSlogger.hpp"
+
+WitnessChecker::WitnessChecker(const Trace& trace, bool verbose)
+    : events_(trace.getAllEvents()),
+      thread_of_(events_.size(), 0),
+      local_idx_(events_.size(), 0),
+      verbose_(verbose) {
+    for (const Thread& thread : trace.getThreads()) {
+        uint32_t local = 0;
+        for (const Event& e : thread.getEvents()) {
+            thread_of_[e.getEventId() - 1] = next_.size();
+            local_idx_[e.getEventId() - 1] = local++;
+        }
+        next_.push_back(0);
+    }
+}
+
+bool WitnessChecker::check(const std::vector<uint32_t>& witness) {
+    LOG_INIT_COUT();
+    std::fill(next_.begin(), next_.end(), 0);
+
+    std::unordered_map<uint32_t, uint32_t>
+        variableIdToVal;  // variable id -> supposed value of the variable
+
+    std::unordered_map<uint32_t, bool>
+        lockIdToLockStatus;  // lock id -> lock availability
+    std::unordered_map<uint32_t, uint32_t>
+        lockIdToThread;  // lock id -> thread id holding the lock
+
+
+    size_t i = 0;
+    for (auto e : witness) {
+        if (i >= witness.size() - 2)
+            break; // the last two events are the COP themselevs
+
+        const Event& event = events_[e - 1];
+        uint32_t threadId = event.getThreadId();
+
+        /* Check if all the preceding events in the same thread has occured */
+        uint32_t& next = next_[thread_of_[e - 1]];
+        if (local_idx_[e - 1] != next) {
+            if (verbose_) log(LOG_INFO) << "Thread check failed\n";
+            return false;
+        } else {
+            next++;
+        }
+
+        /* If its a lock, ensure it is consistent */
+        if (event.getEventType() == Event::EventType::Acquire) {
+            uint32_t lockId = event.getTargetId();
+            if (lockIdToLockStatus.find(lockId) != lockIdToLockStatus.end() &&
+                !lockIdToLockStatus[lockId]) {
+                if (verbose_) {
+                    log(LOG_INFO) << "Lock Acquire failed.\n";
+                    log(LOG_INFO) << "Event: " << event.getEventId() << "\n";
+                }
+                return false;
+            }
+            lockIdToLockStatus[event.getTargetId()] = false;
+            lockIdToThread[lockId] = threadId;
+        } else if (event.getEventType() == Event::EventType::Release) {
+            uint32_t lockId = event.getTargetId();
+            if (lockIdToLockStatus.find(lockId) == lockIdToLockStatus.end() ||
+                lockIdToLockStatus[lockId] ||
+                lockIdToThread.find(lockId) == lockIdToThread.end() ||
+                lockIdToThread[lockId] != threadId) {
+                if (verbose_) log(LOG_INFO) << "Lock Release failed\n";
+                return false;
+            }
+            lockIdToLockStatus[lockId] = true;
+        }
+
+        /* If its a variable, ensure the reads get their value from the latest
+         * write */
+        if (event.getEventType() == Event::EventType::Read) {
+            uint32_t varId = event.getTargetId();
+
+            if (variableIdToVal.find(varId) == variableIdToVal.end()) {
+                variableIdToVal[varId] = event.getTargetValue();
+            }
+
+            if (variableIdToVal[varId] != event.getTargetValue()) {
+                if (verbose_) {
+                    log(LOG_INFO) << "Variable Read failed for: "
+                                  << event.getEventId() << "\n";
+                    log(LOG_INFO) << "Expected: " << variableIdToVal[varId]
+                                  << " Got: " << event.getTargetValue() << "\n";
+                    log(LOG_INFO) << "varId: " << event.getTargetId() << "\n";
+                }
+                return false;
+            }
+        } else if (event.getEventType() == Event::EventType::Write) {
+            variableIdToVal[event.getTargetId()] = event.getTargetValue();
+        }
+
+        i++;
+    }
+
+    return true;
+}
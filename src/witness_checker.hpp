@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "trace.hpp"
+
+/**
+ * WitnessChecker checks that a witness prefix is a feasible execution of
+ * the trace: every thread runs in program order, locks are well nested
+ * between threads and every read sees the value it read in the trace. The
+ * last two events are the COP itself and are not checked. The per-thread
+ * positions of the events are indexed once, so a check only costs as much
+ * as its witness. Only a verbose checker logs why a witness failed.
+ */
+class WitnessChecker {
+   private:
+    std::vector<Event> events_;        // by event idx
+    std::vector<uint32_t> thread_of_;  // dense thread idx by event idx
+    std::vector<uint32_t> local_idx_;  // position in the thread by event idx
+    std::vector<uint32_t> next_;       // next position per thread, per check
+    bool verbose_;
+
+   public:
+    WitnessChecker(const Trace& trace, bool verbose);
+
+    bool check(const std::vector<uint32_t>& witness);
+};
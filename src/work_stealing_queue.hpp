@@ -0,0 +1,60 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * WorkStealingQueue keeps one deque of items per worker. A worker takes
+ * items from the front of its own deque, so it runs through them in the
+ * order they were pushed, and once that is empty it steals from the back of
+ * the other deques.
+ */
+template <typename T>
+class WorkStealingQueue {
+   private:
+    struct Lane {
+        std::mutex mutex;
+        std::deque<T> items;
+    };
+
+    std::vector<std::unique_ptr<Lane>> lanes_;
+
+   public:
+    explicit WorkStealingQueue(size_t laneCount) {
+        for (size_t i = 0; i < laneCount; ++i)
+            lanes_.push_back(std::make_unique<Lane>());
+    }
+
+    size_t getLaneCount() const { return lanes_.size(); }
+
+    void push(size_t lane, T item) {
+        std::lock_guard<std::mutex> guard(lanes_[lane]->mutex);
+        lanes_[lane]->items.push_back(std::move(item));
+    }
+
+    bool pop(size_t lane, T& item) {
+        {
+            Lane& own = *lanes_[lane];
+            std::lock_guard<std::mutex> guard(own.mutex);
+            if (!own.items.empty()) {
+                item = std::move(own.items.front());
+                own.items.pop_front();
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < lanes_.size(); ++i) {
+            Lane& victim = *lanes_[(lane + i) % lanes_.size()];
+            std::lock_guard<std::mutex> guard(victim.mutex);
+            if (!victim.items.empty()) {
+                item = std::move(victim.items.back());
+                victim.items.pop_back();
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <z3++.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Z3Config names a Z3 setup for the QF_IDL race queries. The first entry,
+ * the difference logic arithmetic solver without auto configuration, is what
+ * the model solves with unless another one is pinned; the portfolio races
+ * the others against it.
+ */
+struct Z3Config {
+    std::string name;
+    bool auto_config;
+    unsigned arith_solver;  // smt.arith.solver, ignored with auto_config
+    unsigned random_seed;
+};
+
+inline const std::vector<Z3Config>& getZ3Configs() {
+    static const std::vector<Z3Config> configs = {
+        {"idl", false, 1, 0},        // Bellman-Ford difference logic
+        {"simplex", false, 2, 0},    // the old simplex arithmetic solver
+        {"dense-idl", false, 3, 0},  // Floyd-Warshall difference logic
+        {"lra", false, 6, 0},        // the new linear arithmetic solver
+        {"auto", true, 0, 0},        // whatever Z3 picks for the logic
+        {"idl-seed", false, 1, 7},   // difference logic, other decisions
+    };
+    return configs;
+}
+
+inline const Z3Config& findZ3Config(const std::string& name) {
+    for (const Z3Config& config : getZ3Configs()) {
+        if (config.name == name) return config;
+    }
+    throw std::runtime_error("Unknown Z3 configuration: " + name);
+}
+
+inline void applyZ3Config(z3::solver& s, const Z3Config& config) {
+    z3::params p(s.ctx());
+    p.set("auto_config", config.auto_config);
+    if (!config.auto_config)
+        p.set("smt.arith.solver", config.arith_solver);
+    if (config.random_seed) p.set("random_seed", config.random_seed);
+    s.set(p);
+}
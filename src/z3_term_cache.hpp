@@ -0,0 +1,78 @@
+#pragma once
+
+#include <z3++.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "event.hpp"
+
+/**
+ * Z3TermCache hands out the order (int) and phi (bool) variable of an event,
+ * indexed directly by EID. Variables are created on first use only, and with
+ * integer symbols (2 * eid for the order, 2 * eid + 1 for phi) so no string
+ * is built or interned per lookup. decode maps a model constant back to its
+ * event.
+ */
+class Z3TermCache {
+   public:
+    enum class Kind { Order, Phi };
+
+   private:
+    z3::context& c_;
+    z3::sort int_sort_;
+    z3::sort bool_sort_;
+
+    std::vector<z3::expr> order_vars_;
+    std::vector<z3::expr> phi_vars_;
+    uint64_t created_ = 0;
+
+    static constexpr uint32_t kKindBits = 1;
+
+    z3::expr& lookup(std::vector<z3::expr>& vars, EID eid) {
+        if (eid >= vars.size()) vars.resize(eid + 1, z3::expr(c_));
+        return vars[eid];
+    }
+
+    z3::expr make(EID eid, Kind kind) {
+        created_++;
+        int symbol = static_cast<int>((eid << kKindBits) |
+                                      (kind == Kind::Phi ? 1 : 0));
+        return c_.constant(c_.int_symbol(symbol),
+                           kind == Kind::Phi ? bool_sort_ : int_sort_);
+    }
+
+   public:
+    Z3TermCache(z3::context& c, size_t eventCount)
+        : c_(c),
+          int_sort_(c.int_sort()),
+          bool_sort_(c.bool_sort()),
+          order_vars_(eventCount + 1, z3::expr(c)),
+          phi_vars_(eventCount + 1, z3::expr(c)) {}
+
+    const z3::expr& order(EID eid) {
+        z3::expr& var = lookup(order_vars_, eid);
+        if (!static_cast<Z3_ast>(var)) var = make(eid, Kind::Order);
+        return var;
+    }
+
+    const z3::expr& phi(EID eid) {
+        z3::expr& var = lookup(phi_vars_, eid);
+        if (!static_cast<Z3_ast>(var)) var = make(eid, Kind::Phi);
+        return var;
+    }
+
+    /* number of variables created so far */
+    uint64_t getCreatedCount() const { return created_; }
+
+    /* recovers the event of a model constant, false for other constants */
+    static bool decode(const z3::func_decl& decl, EID& eid, Kind& kind) {
+        z3::symbol name = decl.name();
+        if (decl.arity() != 0 || name.kind() != Z3_INT_SYMBOL) return false;
+
+        uint32_t symbol = static_cast<uint32_t>(name.to_int());
+        eid = symbol >> kKindBits;
+        kind = (symbol & 1) ? Kind::Phi : Kind::Order;
+        return true;
+    }
+};
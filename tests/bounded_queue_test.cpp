@@ -0,0 +1,38 @@
+#include "../src/bounded_queue.hpp"  // Include the BoundedQueue header
+#include <gtest/gtest.h>
+
+#include <thread>
+
+// Items come out in push order and a closed queue is drained first
+TEST(BoundedQueueTest, DrainsAfterClose) {
+    BoundedQueue<int> queue(4);
+    EXPECT_TRUE(queue.push(1));
+    EXPECT_TRUE(queue.push(2));
+    queue.close();
+    EXPECT_FALSE(queue.push(3));
+
+    int item = 0;
+    ASSERT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, 1);
+    ASSERT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, 2);
+    EXPECT_FALSE(queue.pop(item));
+    EXPECT_EQ(queue.getStats().pushed, 2u);
+}
+
+// A push into a full queue waits until the consumer takes an item
+TEST(BoundedQueueTest, PushWaitsWhileFull) {
+    BoundedQueue<int> queue(1);
+    ASSERT_TRUE(queue.push(1));
+
+    std::thread producer([&queue]() { queue.push(2); });
+    while (queue.getStats().full_waits == 0) std::this_thread::yield();
+
+    int item = 0;
+    ASSERT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, 1);
+    producer.join();
+    ASSERT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, 2);
+    EXPECT_EQ(queue.getStats().full_waits, 1u);
+}
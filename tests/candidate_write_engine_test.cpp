@@ -0,0 +1,72 @@
+#include "../src/candidate_write_engine.hpp"  // Include the CandidateWriteEngine header
+#include <gtest/gtest.h>
+
+#include "test_trace.hpp"
+
+namespace {
+
+std::vector<EID> ids(const std::vector<Event>& events) {
+    std::vector<EID> res;
+    for (const Event& e : events) res.push_back(e.getEventId());
+    return res;
+}
+
+}  // namespace
+
+// A good write that happens before another good write of the read is dropped
+TEST(CandidateWriteEngineTest, DominatedGoodWrite) {
+    TestTrace test({
+        raw(Event::Write, 1, 0, 1),  // e1
+        raw(Event::Write, 1, 0, 1),  // e2
+        raw(Event::Fork, 1, 2, 0),   // e3
+        raw(Event::Begin, 2, 0, 0),  // e4
+        raw(Event::Read, 2, 0, 1),   // e5
+    });
+    CandidateWriteEngine engine(test.trace, test.clocks);
+
+    CandidateWriteEngine::Candidates candidates =
+        engine.takeCandidates(test.trace.getEvent(5));
+
+    EXPECT_EQ(ids(candidates.good_writes), std::vector<EID>({2}));
+    EXPECT_TRUE(candidates.bad_writes.empty());
+}
+
+// Concurrent good writes survive, writes after the read are dropped
+TEST(CandidateWriteEngineTest, ConcurrentWrites) {
+    TestTrace test({
+        raw(Event::Fork, 1, 2, 0),   // e1
+        raw(Event::Begin, 2, 0, 0),  // e2
+        raw(Event::Write, 1, 0, 1),  // e3
+        raw(Event::Write, 2, 0, 2),  // e4
+        raw(Event::Write, 2, 0, 1),  // e5
+        raw(Event::Read, 1, 0, 1),   // e6
+        raw(Event::Write, 1, 0, 2),  // e7
+    });
+    CandidateWriteEngine engine(test.trace, test.clocks);
+
+    CandidateWriteEngine::Candidates candidates =
+        engine.takeCandidates(test.trace.getEvent(6));
+
+    EXPECT_EQ(ids(candidates.good_writes), std::vector<EID>({3, 5}));
+    EXPECT_EQ(ids(candidates.bad_writes), std::vector<EID>({4}));
+}
+
+// Writes that happen before the dominating event are filtered out
+TEST(CandidateWriteEngineTest, FilterDominated) {
+    TestTrace test({
+        raw(Event::Fork, 1, 2, 0),   // e1
+        raw(Event::Write, 1, 0, 2),  // e2
+        raw(Event::Begin, 2, 0, 0),  // e3
+        raw(Event::Write, 2, 0, 2),  // e4
+        raw(Event::Write, 1, 0, 1),  // e5
+        raw(Event::Read, 1, 0, 2),   // e6
+    });
+    CandidateWriteEngine engine(test.trace, test.clocks);
+
+    CandidateWriteEngine::Candidates candidates =
+        engine.takeCandidates(test.trace.getEvent(6));
+    EXPECT_EQ(ids(candidates.good_writes), std::vector<EID>({2, 4}));
+
+    engine.filterDominated(candidates.good_writes, test.trace.getEvent(5));
+    EXPECT_EQ(ids(candidates.good_writes), std::vector<EID>({4}));
+}
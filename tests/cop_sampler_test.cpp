@@ -0,0 +1,64 @@
+#include "../src/cop_sampler.hpp"  // Include the COPSampler header
+#include <gtest/gtest.h>
+
+namespace {
+
+Event write(EID eid, uint32_t tid, uint32_t var) {
+    return Event(Event::createRawEvent(Event::Write, tid, var, 0), eid);
+}
+
+/* n COPs of var 0 and threads 1, 2 followed by m of var 1, all early in a
+ * trace of 100 events */
+std::vector<std::pair<Event, Event>> makeCOPs(size_t n, size_t m) {
+    std::vector<std::pair<Event, Event>> cops;
+    for (size_t i = 0; i < n + m; ++i) {
+        uint32_t var = i < n ? 0 : 1;
+        cops.push_back({write(1, 1, var), write(2, 2, var)});
+    }
+    return cops;
+}
+
+}  // namespace
+
+// The budget is spread by stratum size and every stratum gets a COP
+TEST(COPSamplerTest, ProportionalAllocation) {
+    std::vector<std::pair<Event, Event>> cops = makeCOPs(91, 9);
+    COPSampler sampler(100, 4, 1);
+
+    std::vector<size_t> sample = sampler.draw(cops, 20);
+    ASSERT_EQ(sample.size(), 20u);
+    EXPECT_EQ(sampler.getStrataCount(), 2u);
+
+    size_t second = std::count_if(sample.begin(), sample.end(),
+                                  [](size_t i) { return i >= 91; });
+    EXPECT_EQ(second, 2u);
+    EXPECT_TRUE(std::is_sorted(sample.begin(), sample.end()));
+}
+
+// The same seed draws the same sample
+TEST(COPSamplerTest, FixedSeed) {
+    std::vector<std::pair<Event, Event>> cops = makeCOPs(50, 50);
+    COPSampler first(100, 4, 7), second(100, 4, 7);
+
+    EXPECT_EQ(first.draw(cops, 10), second.draw(cops, 10));
+}
+
+// A sample of every COP gives the exact rate and no interval
+TEST(COPSamplerTest, FullSampleIsExact) {
+    std::vector<std::pair<Event, Event>> cops = makeCOPs(6, 4);
+    COPSampler sampler(100, 4, 1);
+
+    std::vector<size_t> sample = sampler.draw(cops, 100);
+    ASSERT_EQ(sample.size(), 10u);
+
+    std::vector<uint8_t> isRace = {1, 1, 1, 0, 0, 0, 1, 0, 0, 0};
+    COPSampler::Estimate estimate = sampler.estimate(isRace);
+    EXPECT_EQ(estimate.races, 4u);
+    EXPECT_DOUBLE_EQ(estimate.rate, 0.4);
+    EXPECT_DOUBLE_EQ(estimate.low, 0.4);
+    EXPECT_DOUBLE_EQ(estimate.high, 0.4);
+
+    COPSampler::Estimate var1 = sampler.estimate(isRace, 1);
+    EXPECT_EQ(var1.cops, 4u);
+    EXPECT_DOUBLE_EQ(var1.rate, 0.25);
+}
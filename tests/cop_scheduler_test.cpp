@@ -0,0 +1,48 @@
+#include "../src/cop_scheduler.hpp"  // Include the COPScheduler header
+#include <gtest/gtest.h>
+
+#include "test_trace.hpp"
+
+// The cone of a COP joins the causal pasts of both events
+TEST(COPSchedulerTest, Features) {
+    TestTrace test({
+        raw(Event::Fork, 1, 2, 0),     // e1
+        raw(Event::Begin, 2, 0, 0),    // e2
+        raw(Event::Read, 1, 1, 0),     // e3
+        raw(Event::Acquire, 1, 5, 0),  // e4
+        raw(Event::Write, 1, 0, 1),    // e5
+        raw(Event::Release, 1, 5, 0),  // e6
+        raw(Event::Read, 2, 0, 0),     // e7
+    });
+    COPScheduler scheduler(test.trace, test.clocks);
+
+    COPScheduler::Features f =
+        scheduler.features(test.trace.getEvent(5), test.trace.getEvent(7));
+    EXPECT_EQ(f.distance, 2u);
+    EXPECT_EQ(f.cone, 6u);  // e1 to e5 and e2, e7
+    EXPECT_EQ(f.phi_reads, 2u);
+    EXPECT_EQ(f.lock_depth, 1u);
+}
+
+// Every pass takes the best COP of each variable before a second one
+TEST(COPSchedulerTest, SpreadOverVariables) {
+    TestTrace test({
+        raw(Event::Fork, 1, 2, 0),   // e1
+        raw(Event::Begin, 2, 0, 0),  // e2
+        raw(Event::Write, 1, 0, 1),  // e3
+        raw(Event::Write, 2, 0, 2),  // e4
+        raw(Event::Write, 1, 0, 3),  // e5
+        raw(Event::Write, 2, 0, 4),  // e6
+        raw(Event::Write, 1, 1, 1),  // e7
+        raw(Event::Write, 2, 1, 2),  // e8
+    });
+    COPScheduler scheduler(test.trace, test.clocks);
+
+    std::vector<std::pair<Event, Event>> cops = {
+        {test.trace.getEvent(5), test.trace.getEvent(6)},
+        {test.trace.getEvent(3), test.trace.getEvent(4)},
+        {test.trace.getEvent(7), test.trace.getEvent(8)},  // the largest cone
+    };
+    EXPECT_EQ(scheduler.order(cops), std::vector<size_t>({1, 2, 0}));
+    EXPECT_EQ(scheduler.getStats().groups, 2u);
+}
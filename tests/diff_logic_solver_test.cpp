@@ -0,0 +1,73 @@
+#include "../src/diff_logic_solver.hpp"  // Include the DiffLogicSolver header
+#include <gtest/gtest.h>
+
+using Lit = DiffLogicSolver::Lit;
+
+// A chain of strict orders is satisfiable and the model respects it
+TEST(DiffLogicSolverTest, ChainModel) {
+    DiffLogicSolver solver;
+    uint32_t zero = solver.newNode();
+    uint32_t a = solver.newNode(), b = solver.newNode(), c = solver.newNode();
+
+    solver.addClause({solver.atom(a, b, -1)});  // a < b
+    solver.addClause({solver.atom(b, c, -1)});  // b < c
+
+    ASSERT_EQ(solver.check(), DiffLogicSolver::Result::Sat);
+    EXPECT_LT(solver.modelValue(a, zero), solver.modelValue(b, zero));
+    EXPECT_LT(solver.modelValue(b, zero), solver.modelValue(c, zero));
+}
+
+// a < b, b < c and c < a close a negative cycle
+TEST(DiffLogicSolverTest, NegativeCycle) {
+    DiffLogicSolver solver;
+    uint32_t a = solver.newNode(), b = solver.newNode(), c = solver.newNode();
+
+    solver.addClause({solver.atom(a, b, -1)});
+    solver.addClause({solver.atom(b, c, -1)});
+    solver.addClause({solver.atom(c, a, -1)});
+
+    EXPECT_EQ(solver.check(), DiffLogicSolver::Result::Unsat);
+}
+
+// The mutual exclusion of two critical sections picks one order
+TEST(DiffLogicSolverTest, LockXor) {
+    DiffLogicSolver solver;
+    uint32_t zero = solver.newNode();
+    uint32_t acq1 = solver.newNode(), rel1 = solver.newNode();
+    uint32_t acq2 = solver.newNode(), rel2 = solver.newNode();
+
+    solver.addClause({solver.atom(acq1, rel1, -1)});
+    solver.addClause({solver.atom(acq2, rel2, -1)});
+    Lit first = solver.atom(rel1, acq2, -1);
+    Lit second = solver.atom(rel2, acq1, -1);
+    solver.addClause({first, second});
+
+    /* both sections must hold at one point in time */
+    Lit overlap = solver.atom(acq2, rel1, -1);
+    Lit overlap2 = solver.atom(acq1, rel2, -1);
+    EXPECT_EQ(solver.check({overlap, overlap2}),
+              DiffLogicSolver::Result::Unsat);
+
+    ASSERT_EQ(solver.check({DiffLogicSolver::negate(first)}),
+              DiffLogicSolver::Result::Sat);
+    EXPECT_LT(solver.modelValue(rel2, zero), solver.modelValue(acq1, zero));
+}
+
+// An unsat check reports only the assumptions it needed
+TEST(DiffLogicSolverTest, AssumptionCore) {
+    DiffLogicSolver solver;
+    uint32_t a = solver.newNode(), b = solver.newNode();
+    uint32_t x = solver.newVar();
+
+    solver.addClause({solver.atom(a, b, -1)});
+    Lit le = solver.atom(b, a, 0);  // b <= a
+    Lit free = DiffLogicSolver::mkLit(x);
+
+    ASSERT_EQ(solver.check({free, le}), DiffLogicSolver::Result::Unsat);
+    const std::vector<Lit>& core = solver.getCore();
+    EXPECT_NE(std::find(core.begin(), core.end(), le), core.end());
+    EXPECT_EQ(std::find(core.begin(), core.end(), free), core.end());
+
+    /* the solver stays usable after an unsat assumption */
+    EXPECT_EQ(solver.check({free}), DiffLogicSolver::Result::Sat);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../src/event.hpp"
+#include "../src/trace.hpp"
+#include "../src/vector_clock.hpp"
+
+inline uint64_t raw(Event::EventType type, uint32_t tid, uint32_t target,
+                    uint32_t value) {
+    return Event::createRawEvent(type, tid, target, value);
+}
+
+/* a trace of raw events, numbered e1, e2, ... in order, with its MHB
+ * clocks, which is what the engines under test are built from */
+struct TestTrace {
+    Trace trace;
+    MHBClocks clocks;
+
+    explicit TestTrace(const std::vector<uint64_t>& rawEvents)
+        : trace(Trace::createTrace(rawEvents)), clocks(trace) {}
+};